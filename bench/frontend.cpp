@@ -0,0 +1,381 @@
+/*
+ * front-end throughput benchmark, built and run by 'make bench-frontend'.
+ *
+ * generates synthetic OWL sources of a few shapes, then times lexing,
+ * parsing and validation (validate, lower and sema) of each separately.
+ * every phase is run several times and the fastest run is reported, along
+ * with the heap allocations (operator new) and arena bytes of that phase.
+ *
+ * numbers are only comparable between builds with the same compiler flags.
+ *
+ * usage: benchFrontend [-n scale] [-r repeats] [-s shape]... [-o corpus dir]
+ */
+
+#include "ast.hpp"
+#include "parser.hpp"
+#include "bufferLexer.hpp"
+#include "streamLexer.hpp"
+#include "message.hpp"
+#include "file.hpp"
+
+#include <llvm/Support/TimeValue.h>
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static size_t allocations = 0;
+static size_t allocatedBytes = 0;
+
+void *operator new(size_t size) {
+    allocations++;
+    allocatedBytes += size;
+    void *p = malloc(size ? size : 1);
+    if(!p) abort(); // built without exceptions
+    return p;
+}
+
+void *operator new[](size_t size) {
+    return operator new(size);
+}
+
+void operator delete(void *p) throw() {
+    free(p);
+}
+
+void operator delete[](void *p) throw() {
+    free(p);
+}
+
+static uint64_t now() {
+    return llvm::sys::TimeValue::now().usec();
+}
+
+struct Corpus
+{
+    std::string dir;
+    std::vector<std::string> files; // the first one is the main module
+    size_t lines;
+    size_t tokens; // not counting comments
+
+    Corpus(std::string d) : dir(d), lines(0), tokens(0) {}
+
+    std::string path(std::string name) { return dir + "/" + name; }
+
+    void write(std::string name, std::string source) {
+        std::string filenm = path(name);
+        std::ofstream out(filenm.c_str());
+        out << source;
+        if(!out) emit_message(msg::FATAL, "unable to write '" + filenm + "'");
+
+        files.push_back(filenm);
+        for(size_t i = 0; i < source.length(); i++) {
+            if(source[i] == '\n') lines++;
+        }
+    }
+};
+
+static std::string str(int i) {
+    std::stringstream ss;
+    ss << i;
+    return ss.str();
+}
+
+static std::string mainFunction(std::string body = "") {
+    return "int main(int argc, char^^ argv) {\n" + body + "    return 0\n}\n";
+}
+
+// expressions nested 64 deep, mixing operators, parentheses and calls
+static void generateDeep(Corpus &corpus, int scale) {
+    std::string src;
+    for(int i = 0; i < scale; i++) {
+        std::string e = "a";
+        for(int d = 0; d < 64; d++) {
+            switch(d % 4) {
+                case 0: e = "(" + e + " + b * " + str(d) + ")"; break;
+                case 1: e = "(" + e + " - (a - " + str(d) + "))"; break;
+                case 2: e = "(" + e + " * (b + 1))"; break;
+                case 3:
+                    // every call nests its argument; resolving nested calls is costly
+                    if(i && d % 8 == 7) e = "deep" + str(i - 1) + "(" + e + ", b)";
+                    else e = "(" + e + " + 1)";
+                    break;
+            }
+        }
+        src += "int deep" + str(i) + "(int a, int b) {\n    return " + e + "\n}\n\n";
+    }
+    corpus.write("deep.wl", src + mainFunction());
+}
+
+// many small functions with locals, branches and loops
+static void generateFunctions(Corpus &corpus, int scale) {
+    std::string src;
+    for(int i = 0; i < scale * 20; i++) {
+        std::string n = str(i);
+        src += "int fn" + n + "(int a, int b) {\n"
+               "    int c = a + b * " + n + "\n"
+               "    while(c < 100) c = c + a\n"
+               "    if(c > " + n + ") return c - a\n";
+        src += i ? "    return fn" + str(i - 1) + "(b, c)\n}\n\n" : "    return c\n}\n\n";
+    }
+    corpus.write("functions.wl", src + mainFunction());
+}
+
+// classes with 100 fields and 100 methods each
+static void generateClasses(Corpus &corpus, int scale) {
+    std::string src;
+    std::string body;
+    for(int i = 0; i < scale / 20 + 1; i++) {
+        std::string cls = "Class" + str(i);
+        src += "class " + cls + "\n{\n";
+        for(int j = 0; j < 100; j++) {
+            src += std::string(j % 2 ? "    int" : "    float") + " field" + str(j) + "\n";
+        }
+        for(int j = 0; j < 100; j++) {
+            std::string n = str(j);
+            src += "\n    int method" + n + "(int x) {\n"
+                   "        return .field" + str(j - j % 2 + 1) + " + x * " + n + "\n"
+                   "    }\n";
+        }
+        src += "}\n\n";
+        body += "    " + cls + " c" + str(i) + " = new " + cls + "\n"
+                "    c" + str(i) + ".method1(" + str(i) + ")\n";
+    }
+    corpus.write("classes.wl", src + mainFunction(body));
+}
+
+// a main module importing many modules, each also importing the one before it
+static void generateImports(Corpus &corpus, int scale) {
+    std::string body;
+    std::string imports;
+    for(int i = 0; i < scale; i++) {
+        std::string n = str(i);
+        std::string src;
+        if(i) src += "import \"" + corpus.path("module" + str(i - 1) + ".wl") + "\"\n\n";
+        src += "struct Struct" + n + "\n{\n    int a\n    int b\n}\n\n";
+        for(int j = 0; j < 10; j++) {
+            std::string fn = "m" + n + "_" + str(j);
+            src += "int " + fn + "(Struct" + n + "^ s, int x) {\n"
+                   "    return s.a * x + s.b - " + str(j) + "\n}\n\n";
+        }
+        corpus.write("module" + n + ".wl", src);
+
+        imports += "import \"" + corpus.path("module" + n + ".wl") + "\"\n";
+        body += "    Struct" + n + " s" + n + "\n"
+                "    m" + n + "_0(&s" + n + ", " + n + ")\n";
+    }
+
+    // the main module is parsed first
+    corpus.write("imports.wl", imports + "\n" + mainFunction(body));
+    corpus.files.insert(corpus.files.begin(), corpus.files.back());
+    corpus.files.pop_back();
+}
+
+struct Shape
+{
+    const char *name;
+    void (*generate)(Corpus &corpus, int scale);
+};
+
+static Shape shapes[] = {
+    { "deep", generateDeep },
+    { "functions", generateFunctions },
+    { "classes", generateClasses },
+    { "imports", generateImports },
+};
+
+struct Measure
+{
+    uint64_t usec;
+    size_t allocations;
+    size_t allocatedBytes;
+    size_t arenaBytes;
+
+    Measure() : usec(UINT64_MAX), allocations(0), allocatedBytes(0), arenaBytes(0) {}
+};
+
+// keeps the fastest of several runs
+class Run
+{
+    Measure &measure;
+    Measure current;
+    uint64_t start;
+    size_t startAllocations;
+    size_t startBytes;
+
+    public:
+    Run(Measure &m) : measure(m) {
+        startAllocations = allocations;
+        startBytes = allocatedBytes;
+        start = now();
+    }
+
+    void setArenaBytes(size_t bytes) { current.arenaBytes = bytes; }
+
+    ~Run() {
+        current.usec = now() - start;
+        current.allocations = allocations - startAllocations;
+        current.allocatedBytes = allocatedBytes - startBytes;
+        if(current.usec < measure.usec) measure = current;
+    }
+};
+
+template<typename LexerTy>
+static size_t lexAll(LexerTy &lexer) {
+    size_t tokens = 0;
+    while(!lexer.eof() && lexer.peek().isNot(tok::none)) {
+        if(lexer.get().isNot(tok::comment)) tokens++;
+    }
+    return tokens;
+}
+
+static void lexBuffer(Corpus &corpus, Measure &m) {
+    Run run(m);
+    corpus.tokens = 0;
+    for(int i = 0; i < corpus.files.size(); i++) {
+        BufferLexer lexer(corpus.files[i]);
+        lexer.setFilename(corpus.files[i]);
+        corpus.tokens += lexAll(lexer);
+    }
+}
+
+static void lexStream(Corpus &corpus, Measure &m) {
+    Run run(m);
+    for(int i = 0; i < corpus.files.size(); i++) {
+        std::ifstream stream(corpus.files[i].c_str());
+        StreamLexer lexer(stream);
+        lexer.setFilename(corpus.files[i]);
+        lexAll(lexer);
+    }
+}
+
+// the runtime is parsed outside of the measured time, but is validated with the corpus
+static bool parseAndValidate(Corpus &corpus, Measure &parse, Measure &validate) {
+    Parser parser;
+    AST *ast = parser.getAST();
+    {
+        ArenaScope arena(ast->getArena());
+        Identifier *rt_id = ast->getRootPackage()->getScope()->getInScope("runtime");
+        ModuleDeclaration *runtime = new ModuleDeclaration(ast->getRootPackage(), rt_id, "runtime.wl");
+        rt_id->addDeclaration(runtime, Identifier::ID_MODULE);
+        ast->setRuntimeModule(runtime);
+        parser.parseFile(runtime, new File("runtime.wl"));
+
+        size_t arenaStart = ast->getArena()->bytesAllocated();
+        Run run(parse);
+        std::string filenm = corpus.files[0];
+        Identifier *mod_id = ast->getRootPackage()->getScope()->getInScope(filenm);
+        ModuleDeclaration *module = new ModuleDeclaration(ast->getRootPackage(), mod_id, filenm);
+        mod_id->addDeclaration(module, Identifier::ID_MODULE);
+        module->expl = true;
+        ast->addModule(filenm, module);
+        parser.parseFile(module, new File(filenm));
+        run.setArenaBytes(ast->getArena()->bytesAllocated() - arenaStart);
+    }
+
+    bool valid;
+    {
+        size_t arenaStart = ast->getArena()->bytesAllocated();
+        Run run(validate);
+        valid = ast->validate();
+        run.setArenaBytes(ast->getArena()->bytesAllocated() - arenaStart);
+    }
+
+    delete ast;
+    return valid;
+}
+
+static void report(const char *shape, const char *phase, Corpus &corpus, Measure &m) {
+    double sec = m.usec / 1000000.0;
+    printf("  %-10s %-14s %10.3f %12.0f %12.0f %10lu %10lu %10lu\n", shape, phase,
+            m.usec / 1000.0, sec > 0 ? corpus.tokens / sec : 0.0, sec > 0 ? corpus.lines / sec : 0.0,
+            (unsigned long) m.allocations, (unsigned long) m.allocatedBytes / 1024,
+            (unsigned long) m.arenaBytes / 1024);
+}
+
+static bool benchShape(Shape &shape, std::string dir, int scale, int repeats) {
+    if(!makeDirectory(dir)) {
+        emit_message(msg::ERROR, "unable to create corpus directory '" + dir + "'");
+        return false;
+    }
+
+    Corpus corpus(dir);
+    shape.generate(corpus, scale);
+
+    Measure buffer, stream, parse, validate;
+    for(int i = 0; i < repeats; i++) {
+        lexBuffer(corpus, buffer);
+        lexStream(corpus, stream);
+        if(!parseAndValidate(corpus, parse, validate)) {
+            emit_message(msg::ERROR, std::string("generated '") + shape.name + "' corpus is invalid");
+            return false;
+        }
+    }
+
+    report(shape.name, "lex (buffer)", corpus, buffer);
+    report(shape.name, "lex (stream)", corpus, stream);
+    report(shape.name, "parse", corpus, parse);
+    report(shape.name, "validate", corpus, validate);
+    printf("  %-10s %lu files, %lu lines, %lu tokens\n", "", (unsigned long) corpus.files.size(),
+            (unsigned long) corpus.lines, (unsigned long) corpus.tokens);
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int scale = 200;
+    int repeats = 5;
+    std::string dir = "build/bench/corpus";
+    std::vector<std::string> selected;
+
+    int c;
+    while((c = getopt(argc, argv, "n:r:s:o:")) != -1) {
+        switch(c) {
+            case 'n': scale = atoi(optarg); break;
+            case 'r': repeats = atoi(optarg); break;
+            case 's': selected.push_back(optarg); break;
+            case 'o': dir = optarg; break;
+            default:
+                fprintf(stderr, "usage: %s [-n scale] [-r repeats] [-s shape]... [-o corpus dir]\n", argv[0]);
+                return 1;
+        }
+    }
+
+    if(scale < 1 || repeats < 1) {
+        emit_message(msg::ERROR, "scale and repeats must be positive");
+        return 1;
+    }
+
+    printf("  %-10s %-14s %10s %12s %12s %10s %10s %10s\n", "shape", "phase", "time (ms)",
+            "tokens/s", "lines/s", "allocs", "alloc KB", "arena KB");
+
+    int status = 0;
+    int nshapes = sizeof(shapes) / sizeof(shapes[0]);
+    for(int i = 0; i < nshapes; i++) {
+        bool run = selected.empty();
+        for(int j = 0; j < selected.size(); j++) {
+            if(selected[j] == shapes[i].name) run = true;
+        }
+
+        if(run && !benchShape(shapes[i], dir + "/" + shapes[i].name, scale, repeats)) status = 1;
+    }
+
+    for(int j = 0; j < selected.size(); j++) {
+        bool known = false;
+        for(int i = 0; i < nshapes; i++) {
+            if(selected[j] == shapes[i].name) known = true;
+        }
+        if(!known) {
+            emit_message(msg::ERROR, "unknown shape '" + selected[j] + "'");
+            status = 1;
+        }
+    }
+
+    return status;
+}
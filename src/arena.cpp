@@ -0,0 +1,99 @@
+#include "arena.hpp"
+
+#include <stdlib.h>
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+#define ARENA_CHUNK_SIZE (64 * 1024)
+#define ARENA_ALIGN 16
+
+static THREAD_LOCAL Arena *currentArena = NULL;
+
+Arena::Arena() : ptr(NULL), end(NULL), allocated(0)
+{
+}
+
+Arena::~Arena()
+{
+    release();
+}
+
+void *Arena::allocate(size_t size, void (*destroy)(void*))
+{
+    size = (size + ARENA_ALIGN - 1) & ~(size_t) (ARENA_ALIGN - 1);
+
+    if(size > (size_t) (end - ptr))
+    {
+        // large objects get a chunk of their own, so the current chunk
+        // is not abandoned early
+        size_t chunkSize = size > ARENA_CHUNK_SIZE / 4 ? size : ARENA_CHUNK_SIZE;
+        char *chunk = (char*) malloc(chunkSize);
+        chunks.push_back(chunk);
+
+        if(chunkSize != ARENA_CHUNK_SIZE)
+        {
+            allocated += size;
+            if(destroy)
+            {
+                Cleanup c = { destroy, chunk };
+                cleanups.push_back(c);
+            }
+            return chunk;
+        }
+
+        ptr = chunk;
+        end = chunk + chunkSize;
+    }
+
+    void *ret = ptr;
+    ptr += size;
+    allocated += size;
+
+    if(destroy)
+    {
+        Cleanup c = { destroy, ret };
+        cleanups.push_back(c);
+    }
+
+    return ret;
+}
+
+void Arena::release()
+{
+    for(size_t i = cleanups.size(); i > 0; i--)
+    {
+        cleanups[i-1].destroy(cleanups[i-1].object);
+    }
+    cleanups.clear();
+
+    for(size_t i = 0; i < chunks.size(); i++)
+    {
+        free(chunks[i]);
+    }
+    chunks.clear();
+
+    ptr = end = NULL;
+    allocated = 0;
+}
+
+Arena *Arena::current()
+{
+    if(!currentArena) return process();
+    return currentArena;
+}
+
+Arena *Arena::process()
+{
+    // objects created outside of any AST live as long as the process
+    static Arena processArena;
+    return &processArena;
+}
+
+void Arena::setCurrent(Arena *arena)
+{
+    currentArena = arena;
+}
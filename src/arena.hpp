@@ -0,0 +1,79 @@
+#ifndef _ARENA_HPP
+#define _ARENA_HPP
+
+#include <stddef.h>
+#include <vector>
+
+/*
+ * bump allocator for AST nodes, identifiers and scopes.
+ *
+ * objects are never freed one at a time. release() runs the registered
+ * destructors (in reverse order of allocation) and frees every chunk at
+ * once. the AST owns an arena; objects are allocated from the 'current'
+ * arena of the calling thread, which ArenaScope sets for a block.
+ * a single arena must only be used from one thread at a time
+ */
+class Arena
+{
+    struct Cleanup
+    {
+        void (*destroy)(void*);
+        void *object;
+    };
+
+    std::vector<char*> chunks;
+    std::vector<Cleanup> cleanups;
+    char *ptr;
+    char *end;
+    size_t allocated;
+
+    Arena(const Arena&); // not copyable
+    Arena &operator=(const Arena&);
+
+    public:
+    Arena();
+    ~Arena();
+
+    // 'destroy', if given, is called on the object when the arena is released
+    void *allocate(size_t size, void (*destroy)(void*) = NULL);
+    void release();
+
+    // bytes handed out (not including chunk overhead)
+    size_t bytesAllocated() { return allocated; }
+
+    // the arena new objects go to. if none is set, a process wide arena
+    // that is never released is used
+    static Arena *current();
+    static void setCurrent(Arena *arena);
+
+    // the process wide arena, for objects shared by every AST
+    static Arena *process();
+};
+
+// makes 'arena' current for the lifetime of the scope
+struct ArenaScope
+{
+    Arena *previous;
+
+    ArenaScope(Arena *arena) : previous(Arena::current()) { Arena::setCurrent(arena); }
+    ~ArenaScope() { Arena::setCurrent(previous); }
+};
+
+// calls the destructor of a T allocated in an arena
+template<typename T>
+void destroyInArena(void *object)
+{
+    ((T*) object)->~T();
+}
+
+/*
+ * gives a class arena allocation: 'new' takes memory from the current
+ * arena and registers the destructor, 'delete' does nothing (the arena
+ * frees the memory). for a class hierarchy, T is the base; its
+ * destructor must be virtual
+ */
+#define ARENA_ALLOCATED(T) \
+    static void *operator new(size_t size) { return Arena::current()->allocate(size, destroyInArena<T>); } \
+    static void operator delete(void *ptr) {}
+
+#endif
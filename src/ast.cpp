@@ -3,6 +3,9 @@
 #include "sema.hpp"
 #include "lower.hpp"
 #include "codegenContext.hpp"
+#include "timing.hpp"
+
+#include <algorithm>
 
 
 #if defined WIN32
@@ -84,6 +87,11 @@ unsigned getFileSize(std::string filenm) {
 //
 
 AST::AST(){
+    ArenaScope scope(&arena);
+    runtime = NULL;
+    cmodule = NULL;
+    reorderFields = true;
+    hashSources = false;
     root = new PackageDeclaration(NULL, NULL, SourceLocation(), DeclarationQualifier());
     Identifier *id = root->getScope()->getInScope("__root");
     id->addDeclaration(root, Identifier::ID_PACKAGE);
@@ -91,7 +99,17 @@ AST::AST(){
 }
 
 AST::~AST() {
-    delete root;
+    // the arenas free every node, identifier and scope
+    for(int i = 0; i < threadArenas.size(); i++) {
+        delete threadArenas[i];
+    }
+}
+
+Arena *AST::newArena() {
+    llvm::sys::ScopedLock guard(lock);
+    Arena *a = new Arena;
+    threadArenas.push_back(a);
+    return a;
 }
 
 bool AST::validate() {
@@ -99,11 +117,25 @@ bool AST::validate() {
     Lower lowering;
     Sema sema;
     PackageDeclaration *pdecl = getRootPackage();
+    ArenaScope scope(&arena); // lowering and sema create nodes
 
-    pdecl->accept(&validate);
+    {
+        TimeScope scope("validate");
+        pdecl->accept(&validate);
+    }
+    if(currentErrorLevel() < msg::ERROR && reorderFields) {
+        // before lowering, which is the first to use a layout
+        TimeScope scope("reorder fields");
+        ReorderFields reorder;
+        pdecl->accept(&reorder);
+    }
     if(currentErrorLevel() < msg::ERROR) {
-        pdecl->accept(&lowering);
+        {
+            TimeScope scope("lower");
+            pdecl->accept(&lowering);
+        }
         if(currentErrorLevel() < msg::ERROR) {
+            TimeScope scope("sema");
             pdecl->accept(&sema);
         }
     }
@@ -151,17 +183,26 @@ Expression *FunctionDeclaration::getDefaultParameter(unsigned parami) {
     return parameters[parami]->value;
 }
 
-size_t UserTypeDeclaration::getAlign() const {
-    size_t align = 0;
+const TypeLayout &UserTypeDeclaration::getLayout() const {
+    if(!layout.done) {
+        computeLayout(layout);
+    }
+    return layout;
+}
+
+// lays out the members one after another, in declaration order
+static void layoutMembers(TypeLayout &layout, const std::vector<Declaration*> &members, bool packed) {
     VariableDeclaration *vd;
-    for(int i = 0; i < members.size(); i++){
+    for(int i = 0; i < members.size(); i++) {
         vd = members[i]->variableDeclaration();
         assert(vd && "expected variable decl, found something else");
-        if(vd->getType()->getAlign() > align)
-            align = vd->getType()->getAlign();
+        layout.addMember(vd->getType(), packed);
     }
-    if(align == 0) return 1; // TODO: empty struct, bad!
-    return align; //TODO: handle packed
+}
+
+void UserTypeDeclaration::computeLayout(TypeLayout &layout) const {
+    layoutMembers(layout, members, false);
+    layout.finish();
 }
 
 FunctionDeclaration *UserTypeDeclaration::getMethod(std::string name, ASTFunctionType *opt_ty) {
@@ -209,49 +250,60 @@ long StructDeclaration::getMemberIndex(std::string member){
     return -1;
 }
 
-size_t StructDeclaration::getSize() const {
-    size_t sz = 0;
-    VariableDeclaration *vd;
-    unsigned align;
-    for(int i = 0; i < members.size(); i++) {
-        vd = members[i]->variableDeclaration();
-        if(!vd) continue;
-
-        align = vd->getType()->getAlign();
-        if(!packed && sz % align)
-            sz += (align - (sz % align));
-        sz += vd->type->getSize();
-    }
-    return sz;
+void StructDeclaration::computeLayout(TypeLayout &layout) const {
+    layoutMembers(layout, members, packed);
+    layout.finish(packed);
 }
 
-size_t UnionDeclaration::getSize() const {
-    size_t sz = 0;
+void UnionDeclaration::computeLayout(TypeLayout &layout) const {
     VariableDeclaration *vd;
     for(int i = 0; i < members.size(); i++){
         vd = members[i]->variableDeclaration();
-        if(vd->getType()->getSize() > sz)
-            sz = vd->getType()->getSize();
+        assert(vd && "expected variable decl, found something else");
+        layout.addOverlappingMember(vd->getType());
     }
-    return sz;
+    layout.finish();
 }
 
-size_t ClassDeclaration::getSize() const {
-    size_t sz = base ? base->getDeclaredType()->getSize() : 0;
-    VariableDeclaration *vd;
-    unsigned align = base ? 8 : 1; //TODO: proper padding past base?
-    if(sz % align) sz += (align - (sz % align));
-    for(int i = 0; i < members.size(); i++) {
-        vd = members[i]->variableDeclaration();
-        if(!vd) continue;
-        align = vd->getType()->getAlign();
-        if(sz % align)
-            sz += (align - (sz % align));
-        //reference types treated as pointers
-        if(vd->getType()->isReference()) sz += 8;
-        else sz += vd->type->getSize();
+// base class members come first, then the members declared here
+void ClassDeclaration::computeLayout(TypeLayout &layout) const {
+    if(base) {
+        const TypeLayout &blayout = base->getDeclaration()->userTypeDeclaration()->getLayout();
+        layout.place(blayout.size, blayout.align);
+        layout.padding += blayout.padding;
     }
-    return sz;
+    layoutMembers(layout, members, false);
+    layout.finish();
+}
+
+// larger alignment first, then larger size; otherwise declaration order is kept
+static bool packsBefore(Declaration *a, Declaration *b) {
+    ASTType *aty = a->getType();
+    ASTType *bty = b->getType();
+    if(aty->getAlign() != bty->getAlign()) return aty->getAlign() > bty->getAlign();
+    return TypeLayout::storageSize(aty) > TypeLayout::storageSize(bty);
+}
+
+/*
+ * sorts the members to minimize padding. class layout is not part of any
+ * C interface, and members are found by index, so reordering them is safe.
+ * base members stay first; the root class (Object) is never reordered,
+ * so its vtable and refcount are always at the start of an object.
+ * must run before anything uses the layout
+ */
+void ClassDeclaration::reorderMembers() {
+    if(reordered || !base) return;
+    reordered = true;
+
+    // our layout starts where the base's (final) layout ends
+    ClassDeclaration *bdecl = base->getDeclaration()->classDeclaration();
+    if(bdecl) bdecl->reorderMembers();
+
+    TypeLayout before;
+    computeLayout(before);
+    std::stable_sort(members.begin(), members.end(), packsBefore);
+    layout = TypeLayout();
+    reportFieldReordering(getName(), before.size, getLayout().size);
 }
 
 void ClassDeclaration::populateVTable() {
@@ -380,6 +432,7 @@ ASTType *DotExpression::getType() {
     }
 
     ASTType *lhstype = lhs->getType();
+    if(!lhstype) return NULL; // 'Type.member' names a member, it has no value
 
     if(rhs == "ptr" && lhstype->isArray()) {
         return lhstype->asArray()->arrayOf->getPointerTy();
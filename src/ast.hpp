@@ -24,6 +24,9 @@ std::string getFilebase(std::string s);
 
 unsigned getFileSize(std::string filenm);
 
+#include <llvm/Support/Mutex.h>
+
+#include "arena.hpp"
 #include "astScope.hpp"
 #include "identifier.hpp"
 #include "sourceLocation.hpp"
@@ -50,16 +53,30 @@ struct InterfaceDeclaration;
 
 struct PackageDeclaration;
 struct ModuleDeclaration;
+struct LazyBody;
 
 struct AST
 {
+    Arena arena; // nodes, identifiers and scopes of this AST
+    std::vector<Arena*> threadArenas; // arenas of threads that parsed into this AST
+    llvm::sys::Mutex lock; // held to register modules from parsing threads
     PackageDeclaration *root;
     std::map<std::string, ModuleDeclaration*> modules;
     ModuleDeclaration *runtime;
+    ModuleDeclaration *cmodule; // shared by all C imports
+    bool reorderFields; // lay out class fields to minimize padding, see ReorderFields
+
+    // content hash of each source file as it was read, by path. only kept
+    // if hashSources is set; the compile server checks them before reuse
+    bool hashSources;
+    std::map<std::string, uint64_t> sourceHashes;
 
     AST();
     ~AST();
     PackageDeclaration *getRootPackage() { return root; }
+    Arena *getArena() { return &arena; }
+    Arena *newArena(); // for another thread to parse into; freed with the AST
+    llvm::sys::Mutex &getLock() { return lock; }
     ModuleDeclaration *getModule(std::string str)
     {
         char APATH[PATH_MAX + 1];
@@ -86,38 +103,36 @@ struct AST
 
     ModuleDeclaration *getRuntimeModule() { return runtime; }
 
+    void setCModule(ModuleDeclaration *u) { cmodule = u; }
+    ModuleDeclaration *getCModule() { return cmodule; }
+
+    void setReorderFields(bool reorder) { reorderFields = reorder; }
+
+    void addSourceHash(std::string path, uint64_t h)
+    {
+        llvm::sys::ScopedLock guard(lock);
+        sourceHashes[path] = h;
+    }
+
     void accept(ASTVisitor *v);
     bool validate();
 };
 
+// nodes are allocated in the AST's arena, and freed with the AST
 struct ASTNode {
     private:
-    unsigned refcount;
     ASTNode *parent;
     SourceLocation location;
 
     public:
+    ARENA_ALLOCATED(ASTNode)
 
-    ASTNode() : refcount(1), parent(0) {}
+    ASTNode() : parent(0) {}
     ASTNode(ASTNode *_parent, SourceLocation loc = SourceLocation()) :
-        refcount(1), parent(_parent), location(loc) {}
+        parent(_parent), location(loc) {}
 
     virtual ~ASTNode() {}
 
-    unsigned retain() {
-        refcount++;
-        return refcount;
-    }
-
-    unsigned release() {
-        refcount--;
-        if(refcount <= 0) {
-            delete this;
-            return 0;
-        }
-        return refcount;
-    }
-
     virtual std::string getMangledName() { return ""; }
     virtual std::string getName() { return ""; }
     virtual void accept(ASTVisitor *v) = 0;
@@ -446,6 +461,7 @@ struct ModuleDeclaration : public PackageDeclaration {
 
     std::string filenm;
     bool expl; // explicitly requested for compile. eg, not included
+    std::vector<FunctionDeclaration*> lazyFunctions; // bodies not parsed yet (-flazy-parse)
 
 
     ModuleDeclaration(PackageDeclaration *parent, Identifier *id, std::string fn = "") :
@@ -468,6 +484,7 @@ struct FunctionDeclaration : public Declaration
     int vtableIndex;
     ASTScope *scope;
     Statement *body;
+    LazyBody *lazyBody; // body skipped by -flazy-parse, until it is parsed
 
     FunctionDeclaration *nextoverload; // linked list of overloaded function declarations
 
@@ -475,10 +492,11 @@ struct FunctionDeclaration : public Declaration
             bool varg,  ASTScope *sc, Statement *st, SourceLocation loc, DeclarationQualifier dqual) :
         Declaration(id, loc, dqual), owner(own), prototype(0), returnTy(ret), vararg(varg),
         parameters(params), scope(sc),
-        body(st), nextoverload(0), vtableIndex(-1) {
+        body(st), lazyBody(0), nextoverload(0), vtableIndex(-1) {
             //if(scope)
             //    scope->setOwner(this);
         }
+    bool hasBody() { return body || lazyBody; }
     virtual FunctionDeclaration *functionDeclaration() { return this; }
     ASTScope *getScope() { return scope; }
     ASTType *getReturnType() { return returnTy; }
@@ -559,6 +577,7 @@ struct UserTypeDeclaration : public TypeDeclaration
     std::vector<FunctionDeclaration*> methods; //locally declared methods; does not include methods defined in parent
     std::vector<Declaration*> staticMembers; // these are seperate so that it is easier to work with.
     std::vector<Declaration*> members;
+    mutable TypeLayout layout; // see getLayout
 
     UserTypeDeclaration(Identifier *id, ASTScope *sc, SourceLocation loc, DeclarationQualifier dqual) :
             TypeDeclaration(id, loc, dqual), scope(sc), constructor(0), destructor(0),
@@ -576,8 +595,12 @@ struct UserTypeDeclaration : public TypeDeclaration
     }
     virtual ASTType *getDeclaredType() { return type; }
     virtual size_t length() const { return members.size(); }
-    virtual size_t getAlign() const;
-    virtual size_t getSize() const = 0;
+    virtual size_t getAlign() const { return getLayout().align; }
+    virtual size_t getSize() const { return getLayout().size; }
+
+    // member offsets, size and alignment; computed once, on first use after validation
+    const TypeLayout &getLayout() const;
+    virtual void computeLayout(TypeLayout &layout) const;
     virtual long getMemberIndex(std::string member) = 0;
     virtual void accept(ASTVisitor *v);
     virtual UserTypeDeclaration *userTypeDeclaration() { return this; }
@@ -613,9 +636,10 @@ struct ClassDeclaration : public UserTypeDeclaration {
     Identifier *base;
     ASTValue *typeinfo; //XXX this might be a bad place for this
     std::vector<FunctionDeclaration*> vtable; // populated during validation
+    bool reordered; // members sorted by reorderMembers
     ClassDeclaration(Identifier *id, ASTScope *sc, Identifier *bs,
             SourceLocation loc, DeclarationQualifier dqual) :
-        UserTypeDeclaration(id, sc, loc, dqual), base(bs), typeinfo(0) {
+        UserTypeDeclaration(id, sc, loc, dqual), base(bs), typeinfo(0), reordered(false) {
     }
     virtual Identifier *lookup(std::string member){
         Identifier *id = getScope()->lookupInScope(member);
@@ -629,7 +653,8 @@ struct ClassDeclaration : public UserTypeDeclaration {
     virtual FunctionDeclaration *getMethod(std::string name, ASTFunctionType *opt_ty=NULL);
 
     void populateVTable();
-    virtual size_t getSize() const;
+    void reorderMembers();
+    virtual void computeLayout(TypeLayout &layout) const;
     virtual size_t getAlign() const { return 8; } //XXX align of pointer
     long getMemberIndex(std::string member);
     virtual ClassDeclaration *classDeclaration() { return this; }
@@ -679,7 +704,7 @@ struct StructDeclaration : public UserTypeDeclaration {
            SourceLocation loc, DeclarationQualifier dqual) :
         UserTypeDeclaration(id, sc, loc, dqual), packed(false) {
         }
-    virtual size_t getSize() const;
+    virtual void computeLayout(TypeLayout &layout) const;
     long getMemberIndex(std::string member);
 };
 
@@ -687,7 +712,7 @@ struct UnionDeclaration : public UserTypeDeclaration {
     UnionDeclaration(Identifier *id, ASTScope *sc,
             SourceLocation loc, DeclarationQualifier dqual) :
         UserTypeDeclaration(id, sc, loc, dqual) {}
-    virtual size_t getSize() const;
+    virtual void computeLayout(TypeLayout &layout) const;
     long getMemberIndex(std::string member) { return 0; }
 };
 
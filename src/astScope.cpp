@@ -1,26 +1,164 @@
 #include "astScope.hpp"
 #include "astVisitor.hpp"
 #include "ast.hpp"
+#include "timing.hpp"
 
 #include <iostream>
+#include <algorithm>
+#include <stdint.h>
+
+static size_t hashName(InternedString name)
+{
+    uint64_t h = (uintptr_t) name;
+    h *= 0x9E3779B97F4A7C15ULL;
+    return (size_t) (h >> 32);
+}
+
+size_t SymbolTable::findSlot(InternedString name) const
+{
+    size_t mask = slots.size() - 1;
+    size_t i = hashName(name) & mask;
+    while(slots[i].name && slots[i].name != name)
+    {
+        i = (i + 1) & mask;
+    }
+    return i;
+}
+
+void SymbolTable::grow()
+{
+    std::vector<Slot> old;
+    old.swap(slots);
+
+    Slot empty = { NULL, 0 };
+    slots.resize(old.empty() ? 8 : old.size() * 2, empty);
+    for(size_t i = 0; i < old.size(); i++)
+    {
+        if(old[i].name) slots[findSlot(old[i].name)] = old[i];
+    }
+}
+
+Identifier *SymbolTable::lookup(InternedString name) const
+{
+    if(!count) return NULL;
+    const Slot &slot = slots[findSlot(name)];
+    return slot.name ? entries[slot.index] : NULL;
+}
+
+void SymbolTable::insert(InternedString name, Identifier *id)
+{
+    if((count + 1) * 2 > slots.size()) grow();
+
+    Slot &slot = slots[findSlot(name)];
+    if(slot.name)
+    {
+        entries[slot.index] = NULL;
+    } else
+    {
+        count++;
+    }
+    slot.name = name;
+    slot.index = entries.size();
+    entries.push_back(id);
+    names.push_back(name);
+}
+
+// by name, then by position (a replaced identifier comes before its replacement)
+struct EntryLess
+{
+    const std::vector<InternedString> &names;
+    EntryLess(const std::vector<InternedString> &n) : names(n) {}
+    bool operator()(unsigned a, unsigned b) const
+    {
+        if(names[a] != names[b]) return *names[a] < *names[b];
+        return a < b;
+    }
+};
+
+const std::vector<unsigned> &SymbolTable::nameOrder()
+{
+    size_t sorted = byName.size();
+    if(sorted == entries.size()) return byName;
+
+    for(size_t i = sorted; i < entries.size(); i++) byName.push_back(i);
+    std::sort(byName.begin() + sorted, byName.end(), EntryLess(names));
+    std::inplace_merge(byName.begin(), byName.begin() + sorted, byName.end(), EntryLess(names));
+    version++;
+    return byName;
+}
+
+size_t SymbolTable::orderIndex(unsigned entry)
+{
+    const std::vector<unsigned> &order = nameOrder();
+    return std::lower_bound(order.begin(), order.end(), entry, EntryLess(names)) - order.begin();
+}
+
+void SymbolTable::remove(InternedString name)
+{
+    if(!count) return;
+    size_t i = findSlot(name);
+    if(!slots[i].name) return;
+
+    entries[slots[i].index] = NULL;
+    count--;
+
+    // shift later slots of the probe back, so no probe crosses an empty slot
+    size_t mask = slots.size() - 1;
+    size_t j = i;
+    while(true)
+    {
+        j = (j + 1) & mask;
+        if(!slots[j].name) break;
+
+        size_t home = hashName(slots[j].name) & mask;
+        bool inPlace = i <= j ? (i < home && home <= j) : (i < home || home <= j);
+        if(!inPlace)
+        {
+            slots[i] = slots[j];
+            i = j;
+        }
+    }
+    slots[i].name = NULL;
+}
+
+// moves to the first identifier from 'base' on that has not been removed
+static void skipRemoved(ScopeIterator &it)
+{
+    const std::vector<unsigned> &order = it.scope->symbols.nameOrder();
+    it.version = it.scope->symbols.orderVersion();
+    while(it.base < order.size() && !it.scope->symbols.at(order[it.base])) it.base++;
+
+    if(it.base < order.size()) it.entry = order[it.base];
+    else it.base = ScopeIterator::END;
+}
 
 ScopeIterator::ScopeIterator(ASTScope *sc, Type t, bool rec) :
-    scope(sc), type(t), recurse(rec) {
-    base = scope->symbols.begin();
+    scope(sc), type(t), recurse(rec), base(0), entry(0) {
+    skipRemoved(*this);
 }
 
-ScopeIterator::ScopeIterator(ASTScope *sc, std::map<std::string, Identifier*>::iterator b,
-        Type t, bool rec) : scope(sc), base(b), type(t), recurse(rec) {
+ScopeIterator::ScopeIterator(ASTScope *sc, size_t b, Type t, bool rec) :
+    scope(sc), base(b), entry(0), version(0), type(t), recurse(rec) {
             }
 
+Identifier *ScopeIterator::operator*(){ return scope->symbols.at(entry); }
+Identifier *ScopeIterator::operator->(){ return scope->symbols.at(entry); }
+
 ScopeIterator &ScopeIterator::operator++() {
-	// Windows checks. weird stuff happens...
-	if (scope->empty() || !base->second) return *this;
-	base++;
+    if(base == END) return *this;
+
+    // symbols added since the last step may have moved the current one
+    scope->symbols.nameOrder();
+    if(version != scope->symbols.orderVersion()) base = scope->symbols.orderIndex(entry);
+    base++;
+    skipRemoved(*this);
 	return *this;
 }
 
-bool ScopeIterator::operator==(const ScopeIterator &it){ return (scope->empty() && it.scope->empty()) || it.base == base; }
+bool ScopeIterator::operator==(const ScopeIterator &it){
+    if(it.scope != scope || (it.base == END) != (base == END)) return false;
+    return base == END || it.entry == entry;
+}
 bool ScopeIterator::operator!=(const ScopeIterator &it){ return !(*this == it); }
 
 void ASTScope::addBuiltin()
@@ -36,62 +174,99 @@ void ASTScope::accept(ASTVisitor *v){
 
 void ASTScope::dump()
 {
-    std::map<std::string, Identifier *>::iterator it = symbols.begin();
-    for(; it != symbols.end(); it++)
+    for(iterator it = begin(); it != end(); it++)
     {
-        std::cout << it->first << ": " << it->second->getName() << std::endl;
+        std::cout << it->getName() << std::endl;
     }
 }
 
 bool ASTScope::contains(std::string str)
 {
-    return symbols.count(str) || (parent && parent->contains(str));
+    return contains(intern(str));
+}
+
+bool ASTScope::contains(InternedString str)
+{
+    return symbols.lookup(str) || (parent && parent->contains(str));
 }
 
 void ASTScope::addSibling(ASTScope *t)
 {
     siblings.push_back(t);
+    if(importIndex) importIndex->stale = true;
 }
 
-Identifier *ASTScope::getInScope(std::string str)
+void ASTScope::addSymbol(InternedString str, Identifier *id)
 {
-    if(symbols.count(str))
+    symbols.insert(str, id);
+    symbolsChanged();
+}
+
+// resolutions cached in this module, or in modules importing this scope,
+// may have changed
+void ASTScope::symbolsChanged()
+{
+    if(package) package->getScope()->generation++;
+    for(int i = 0; i < importers.size(); i++)
     {
-        return symbols[str];
-    } else
+        importers[i]->importIndex->stale = true;
+        if(importers[i]->package) importers[i]->package->getScope()->generation++;
+    }
+}
+
+Identifier *ASTScope::getInScope(std::string str)
+{
+    return getInScope(intern(str));
+}
+
+Identifier *ASTScope::getInScope(InternedString str)
+{
+    Identifier *id = symbols.lookup(str);
+    if(!id)
     {
-        Identifier *id = new Identifier(this, str);
-        symbols[str] = id;
-        return id;
+        id = new Identifier(this, str);
+        addSymbol(str, id);
     }
+    return id;
 }
 
 Identifier *ASTScope::get(std::string str)
+{
+    return get(intern(str));
+}
+
+Identifier *ASTScope::get(InternedString str)
 {
     Identifier *id = lookup(str);
 
     if(!id)
     {
         id = new Identifier(this, str);
-        symbols[str] = id;
+        addSymbol(str, id);
     }
 
     return id;
 }
 
 Identifier *ASTScope::lookup(std::string str, bool imports)
+{
+    return lookup(intern(str), imports);
+}
+
+Identifier *ASTScope::lookup(InternedString str, bool imports)
 {
     Identifier *ret = NULL;
     Identifier *id = NULL;
-    if(symbols.count(str))
+    Identifier *local = symbols.lookup(str);
+    if(local)
     {
         // XXX work around for multiple declarations, and forward declarations
-        if(symbols[str]->isUndeclared() && parent)
+        if(local->isUndeclared() && parent)
         {
             id = parent->lookup(str);
             if(id && !id->isUndeclared()) ret = id;
         }
-        ret = symbols[str];
+        ret = local;
     }
 
     if((!ret || ret->isUndeclared()) && parent)
@@ -101,28 +276,101 @@ Identifier *ASTScope::lookup(std::string str, bool imports)
     }
 
 
-    if((!ret || ret->isUndeclared()) && imports)
+    if(!ret && imports && !siblings.empty())
     {
-        for(int i = 0; i < siblings.size() && !ret; i++)
-        {
-            id = siblings[i]->lookup(str, false);
-            if(id && !id->isUndeclared())
-                ret = id;
-        }
+        id = lookupImport(str);
+        if(id) ret = id;
     }
 
     return ret;
 }
 
-Identifier *ASTScope::lookupInScope(std::string str) {
-    if(symbols.count(str)){
-        return symbols[str];
+// the first declared identifier named 'str' in a sibling's own symbols
+Identifier *ASTScope::lookupImport(InternedString str)
+{
+    indexImports();
+    Identifier *id = importIndex->names.lookup(str);
+    if(!id || !id->isUndeclared()) return id;
+
+    // the first sibling with the name has not declared it; a later one may have
+    for(int i = 0; i < siblings.size(); i++)
+    {
+        id = siblings[i]->symbols.lookup(str);
+        if(id && !id->isUndeclared()) return id;
     }
     return NULL;
 }
 
+// brings the import index up to date with symbols added to siblings
+void ASTScope::indexImports()
+{
+    if(!importIndex) importIndex = new ImportIndex;
+    if(!importIndex->stale) return;
+    importIndex->stale = false;
+
+    for(int i = 0; i < siblings.size(); i++)
+    {
+        ASTScope *sibling = siblings[i];
+        if(i == importIndex->indexed.size())
+        {
+            importIndex->indexed.push_back(0);
+            sibling->importers.push_back(this);
+        }
+
+        size_t &n = importIndex->indexed[i];
+        for(; n < sibling->symbols.end(); n++)
+        {
+            Identifier *id = sibling->symbols.at(n);
+            if(!id) continue;
+
+            // an earlier sibling keeps the name
+            Identifier *prev = importIndex->names.lookup(id->getInternedName());
+            int prevSibling = 0;
+            while(prev && prevSibling < i && siblings[prevSibling] != prev->getScope()) prevSibling++;
+            if(!prev || prevSibling >= i)
+            {
+                importIndex->names.insert(id->getInternedName(), id);
+            }
+        }
+    }
+}
+
+// after an indexed identifier is removed from a sibling
+void ASTScope::reindexImport(InternedString str)
+{
+    importIndex->names.remove(str);
+    for(int i = 0; i < importIndex->indexed.size(); i++)
+    {
+        Identifier *id = siblings[i]->symbols.lookup(str);
+        if(id)
+        {
+            importIndex->names.insert(str, id);
+            return;
+        }
+    }
+}
+
+Identifier *ASTScope::lookupInScope(std::string str) {
+    return lookupInScope(intern(str));
+}
+
+Identifier *ASTScope::lookupInScope(InternedString str) {
+    return symbols.lookup(str);
+}
+
 void ASTScope::remove(Identifier *id){
-    symbols.erase(id->getName());
+    InternedString name = id->getInternedName();
+    Identifier *removed = symbols.lookup(name);
+    if(!removed) return;
+
+    symbols.remove(name);
+    for(int i = 0; i < importers.size(); i++)
+    {
+        if(importers[i]->importIndex->names.lookup(name) == removed) importers[i]->reindexImport(name);
+    }
+
+    // resolved identifiers are removed all the time; they were never found by lookup
+    if(!removed->isUndeclared()) symbolsChanged();
 }
 
 ModuleDeclaration *ASTScope::getModule ()
@@ -147,10 +395,34 @@ Identifier *ASTScope::resolveIdentifier(Identifier *id)
         return id;
     }
 
-    Identifier *res = lookup(id->getName(), true);
+    Identifier *res = resolveCached(id->getInternedName());
     if(id != res){
         remove(id);
         id = res;
     }
     return id;
 }
+
+// lookup(), remembering declared results. every occurrence of a name shares
+// one undeclared identifier, and each of them is resolved on its own
+Identifier *ASTScope::resolveCached(InternedString str)
+{
+    if(!package) return lookup(str, true);
+
+    unsigned long current = package->getScope()->generation;
+    if(!resolutionCache) resolutionCache = new ResolutionCache;
+    if(resolutionCache->generation != current)
+    {
+        resolutionCache->names = SymbolTable();
+        resolutionCache->generation = current;
+    }
+
+    Identifier *id = resolutionCache->names.lookup(str);
+    if(id && id->isUndeclared()) id = NULL;
+    countCacheLookup("identifier resolution", id != NULL);
+    if(id) return id;
+
+    id = lookup(str, true);
+    if(id && !id->isUndeclared()) resolutionCache->names.insert(str, id);
+    return id;
+}
@@ -3,11 +3,59 @@
 
 #include <map>
 #include <vector>
+#include <stddef.h>
 #include <string>
 #include <iterator>
 #include "identifier.hpp"
+#include "arena.hpp"
+
+/*
+ * open addressing (linear probing) hash table from interned name to
+ * identifier; names are compared by address. identifiers are also kept in
+ * insertion order, and a removed identifier leaves a NULL entry behind, so
+ * positions stay valid while a table is walked.
+ * scopes are iterated in name order (see nameOrder), as they were when
+ * symbols were kept in a std::map; codegen and release order follow it
+ */
+class SymbolTable
+{
+    struct Slot
+    {
+        InternedString name; // NULL if the slot is empty
+        unsigned index; // into entries
+    };
+
+    std::vector<Slot> slots; // a power of two in size, at most half full
+    std::vector<Identifier*> entries;
+    std::vector<InternedString> names; // of each entry
+    std::vector<unsigned> byName; // entries in name order; later entries are not merged in yet
+    unsigned long version; // bumped when byName is reordered
+    size_t count;
+
+    size_t findSlot(InternedString name) const; // the slot of 'name', or the empty slot ending its probe
+    void grow();
+
+    public:
+    SymbolTable() : version(0), count(0) {}
+
+    Identifier *lookup(InternedString name) const;
+    void insert(InternedString name, Identifier *id); // replaces an identifier of the same name
+    void remove(InternedString name);
+
+    size_t size() const { return count; }
+    bool empty() const { return !count; }
+
+    // positions in insertion order; removed identifiers are NULL
+    size_t end() const { return entries.size(); }
+    Identifier *at(size_t i) const { return entries[i]; }
+
+    // every position, ordered by name. entries added since the last call
+    // are merged in, which moves later positions and bumps orderVersion()
+    const std::vector<unsigned> &nameOrder();
+    unsigned long orderVersion() const { return version; }
+    size_t orderIndex(unsigned entry); // where 'entry' is in nameOrder()
+};
 
-//typedef std::map<std::string, Identifier*>::iterator SymbolIterator;
 class ASTVisitor;
 struct ASTScope;
 struct PackageDeclaration;
@@ -26,22 +74,29 @@ struct ScopeIterator {
     };
     ASTScope *scope;
     Type type;
-    std::map<std::string, Identifier*>::iterator base;
+    size_t base; // index into the scope's name order, or END
+    unsigned entry; // position of the current identifier in the scope's symbols
+    unsigned long version; // of the name order 'base' indexes
     bool recurse;
 
+    // like a std::map iterator, stays valid as symbols are added; symbols
+    // added after the current one are reached
+    static const size_t END = (size_t) -1;
+
     ScopeIterator() : scope(0) {}
     ScopeIterator(ASTScope *sc, Type t, bool rec=false);
-    ScopeIterator(ASTScope *sc, std::map<std::string, Identifier*>::iterator b,
-            Type t, bool rec=false);
+    ScopeIterator(ASTScope *sc, size_t b, Type t, bool rec=false);
     ScopeIterator(const ScopeIterator& it){
         scope = it.scope;
         type = it.type;
         base = it.base;
+        entry = it.entry;
+        version = it.version;
         recurse = it.recurse;
     }
 
-    Identifier *operator*(){ return base->second; }
-    Identifier *operator->(){ return base->second; }
+    Identifier *operator*();
+    Identifier *operator->();
 	ScopeIterator &operator++();
 
     ScopeIterator operator++(int) {
@@ -55,13 +110,42 @@ struct ScopeIterator {
 
 };
 
+// the symbols of a scope's siblings (imports), by name. each name maps to
+// its identifier in the first sibling that has it
+struct ImportIndex
+{
+    SymbolTable names;
+    std::vector<size_t> indexed; // per sibling, how many of its symbols are in 'names'
+    bool stale; // a sibling was added, or gained a symbol
+
+    ARENA_ALLOCATED(ImportIndex)
+
+    ImportIndex() : stale(true) {}
+};
+
+// declared identifiers that resolveIdentifier found from a scope. valid while
+// the generation of the scope's module is unchanged
+struct ResolutionCache
+{
+    SymbolTable names;
+    unsigned long generation;
+
+    ARENA_ALLOCATED(ResolutionCache)
+
+    ResolutionCache() : generation(0) {}
+};
+
 struct ASTNode;
 struct ASTScope
 {
     ASTScope *parent;
     Identifier *owner;
     std::vector<ASTScope*> siblings;
-    std::map<std::string, Identifier *> symbols;
+    SymbolTable symbols;
+    ImportIndex *importIndex; // NULL until a sibling is looked up
+    std::vector<ASTScope*> importers; // scopes whose import index includes this one
+    ResolutionCache *resolutionCache; // NULL until an identifier is resolved here
+    unsigned long generation; // of a module's scope: bumped as the module's symbols change
     std::map<std::string, bool> extensions;
     PackageDeclaration *package;
 
@@ -76,6 +160,8 @@ struct ASTScope
 
     ScopeType type;
 
+    ARENA_ALLOCATED(ASTScope)
+
     bool isUnowned() { return type == Scope_Unowned; }
     bool isGlobalScope() { return type == Scope_Global; }
     bool isParameterScope() { return type == Scope_FunctionParameter; }
@@ -85,7 +171,7 @@ struct ASTScope
 
     typedef ScopeIterator iterator;
     ScopeIterator begin() { return ScopeIterator(this, ScopeIterator::ITER_ALL); }
-    ScopeIterator end() { return ScopeIterator(this, symbols.end(), ScopeIterator::ITER_ALL); }
+    ScopeIterator end() { return ScopeIterator(this, ScopeIterator::END, ScopeIterator::ITER_ALL); }
 
     void setOwner(Identifier *own) { owner = own; }
     Identifier *getOwner() { return owner; }
@@ -110,7 +196,8 @@ struct ASTScope
 
     void dump();
     ASTScope(ASTScope *par = NULL, ScopeType st = Scope_Local, PackageDeclaration *pkg=0) :
-        package(pkg), parent(par), type(st), owner(0)
+        package(pkg), parent(par), type(st), owner(0), importIndex(0),
+        resolutionCache(0), generation(0)
     {
         if(!par) addBuiltin();
         if(par) package = par->package;
@@ -125,15 +212,28 @@ struct ASTScope
     void addSibling(ASTScope *t);
     void addBuiltin();
     bool contains(std::string);
+    bool contains(InternedString);
 	bool empty() { return symbols.empty(); }
     Identifier *getInScope(std::string); // retrieves and creates if non-existant (only from current scope, not parents)
+    Identifier *getInScope(InternedString);
     Identifier *get(std::string); // retrieves and creates if non-existant
+    Identifier *get(InternedString);
     Identifier *lookup(std::string, bool imports=true); // same as 'get', but does not create on not-found
+    Identifier *lookup(InternedString, bool imports=true);
     Identifier *lookupInScope(std::string str);
+    Identifier *lookupInScope(InternedString str);
     void remove(Identifier *id);
     Identifier *resolveIdentifier(Identifier *id);
+    void symbolsChanged(); // a symbol was added or declared here
 
     void accept(ASTVisitor *v);
+
+    private:
+    void addSymbol(InternedString str, Identifier *id);
+    Identifier *lookupImport(InternedString str);
+    void indexImports();
+    void reindexImport(InternedString str);
+    Identifier *resolveCached(InternedString str);
 };
 
 
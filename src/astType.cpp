@@ -2,6 +2,16 @@
 #include "message.hpp"
 #include "astVisitor.hpp"
 
+#include <llvm/Support/Mutex.h>
+
+// types are shared by every AST, and created lazily; imports may be parsed
+// on several threads
+static llvm::sys::Mutex &getTypeLock()
+{
+    static llvm::sys::Mutex lock;
+    return lock;
+}
+
 bool ASTFunctionType::coercesTo(ASTType *t) {
     if(t->is(this)) return true;
 
@@ -107,7 +117,46 @@ long ASTUserType::getVTableIndex(std::string method){
 
 
 long ASTUserType::getMemberOffset(size_t i) {
-    return 0; //TODO
+    const TypeLayout &layout = getDeclaration()->getLayout();
+    if(i >= layout.offsets.size()) return 0;
+    return layout.offsets[i];
+}
+
+//
+// TypeLayout
+//
+size_t TypeLayout::place(size_t sz, size_t al, bool packed) {
+    if(!packed && al > 1) {
+        if(size % al) {
+            padding += al - (size % al);
+            size += al - (size % al);
+        }
+        if(al > align) align = al;
+    }
+    size_t offset = size;
+    size += sz;
+    return offset;
+}
+
+// class values are references, stored as pointers
+size_t TypeLayout::storageSize(ASTType *ty) {
+    if(ty->isReference()) return ASTType::getVoidTy()->getPointerTy()->getSize();
+    return ty->getSize();
+}
+
+void TypeLayout::addMember(ASTType *ty, bool packed) {
+    offsets.push_back(place(storageSize(ty), ty->getAlign(), packed));
+}
+
+void TypeLayout::addOverlappingMember(ASTType *ty) {
+    offsets.push_back(0);
+    if(storageSize(ty) > size) size = storageSize(ty);
+    if(ty->getAlign() > align) align = ty->getAlign();
+}
+
+void TypeLayout::finish(bool packed) {
+    if(!packed) place(0, align);
+    done = true;
 }
 
 //
@@ -151,27 +200,22 @@ size_t ASTDynamicArrayType::getSize() {
 //
 // ASTTupleType
 //
-size_t ASTTupleType::getSize() {
-    size_t sz = 0;
-    unsigned align;
-    for(int i = 0; i < types.size(); i++)
-    {
-        align = types[i]->getAlign();
-        if(sz % align)
-            sz += (align - (sz % align));
-        sz += types[i]->getSize();
+const TypeLayout &ASTTupleType::getLayout() {
+    if(!layout.done) {
+        for(int i = 0; i < types.size(); i++) {
+            layout.addMember(types[i]);
+        }
+        layout.finish();
     }
-    return sz;
+    return layout;
+}
+
+size_t ASTTupleType::getSize() {
+    return getLayout().size;
 }
 
 size_t ASTTupleType::getAlign() {
-    size_t max = 0;
-    for(int i = 0; i < types.size(); i++)
-    {
-        if(types[i]->getAlign() > max)
-            max = types[i]->getAlign();
-    }
-    return max;
+    return getLayout().align;
 }
 
 bool ASTTupleType::coercesTo(ASTType *ty) {
@@ -371,6 +415,7 @@ std::string ASTType::getName()
     }
 
 ASTType *ASTType::getPointerTy() {
+    llvm::sys::ScopedLock guard(getTypeLock());
     if(!pointerTy)
     {
         pointerTy = new ASTPointerType(this);
@@ -387,6 +432,7 @@ ASTType *ASTType::getReferenceTy() {
 }
 
 ASTType *ASTType::getArrayTy() {
+    llvm::sys::ScopedLock guard(getTypeLock());
     if(!dynamicArrayTy)
     {
         dynamicArrayTy = new ASTDynamicArrayType(this);
@@ -399,6 +445,7 @@ ASTType *ASTType::getArrayTy(unsigned sz) {
 }
 
 ASTType *ASTType::getArrayTy(Expression *sz) {
+    llvm::sys::ScopedLock guard(getTypeLock());
     ASTType *aty = 0;
 
     if(sz->intExpression()) {
@@ -406,7 +453,10 @@ ASTType *ASTType::getArrayTy(Expression *sz) {
         if(arrayTy.count(isz)) {
             aty = arrayTy[isz];
         } else {
-            aty = arrayTy[isz] = new ASTStaticArrayType(this, sz);
+            // cached types outlive the AST 'sz' was parsed into
+            ArenaScope scope(Arena::process());
+            Expression *cachedSz = new IntExpression(sz->getType(), isz, sz->loc);
+            aty = arrayTy[isz] = new ASTStaticArrayType(this, cachedSz);
         }
     }
 
@@ -420,6 +470,7 @@ ASTType *ASTType::getArrayTy(Expression *sz) {
 ASTType *ASTType::getConstTy() {
     if(isConst()) return this;
 
+    llvm::sys::ScopedLock guard(getTypeLock());
     if(!constTy) {
         constTy = new ASTConstDecorator(this);
     }
@@ -436,15 +487,16 @@ ASTType *ASTType::getConstTy() {
 
 std::vector<ASTType *> ASTType::typeCache;
 
+static ASTType *cacheType(ASTType *ty) {
+    llvm::sys::ScopedLock guard(getTypeLock());
+    ASTType::typeCache.push_back(ty);
+    return ty;
+}
+
+// function statics are initialized once, even when raced by threads
 #define DECLTY(TYENUM, NM) ASTType *ASTType::get##NM() { \
-    static int id = -1; \
-    ASTType *ty; \
-    if(id < 0) { \
-        ty = new ASTBasicType(TYENUM); \
-        id = typeCache.size(); \
-        typeCache.push_back(ty); \
-    } \
-    return ASTType::typeCache[id]; \
+    static ASTType *ty = cacheType(new ASTBasicType(TYENUM)); \
+    return ty; \
 }
 
     DECLTY(TYPE_VOID, VoidTy)
@@ -467,16 +519,38 @@ std::vector<ASTType *> ASTType::typeCache;
 
 ASTType *ASTType::DynamicTy = 0;
 
+/*
+ * tuple and function types are hash-consed: types built from the same
+ * element types are the same object, so they can be compared by address and
+ * are only generated once. the element types are keyed by address; types are
+ * never freed, so an address is never reused for another type.
+ */
 ASTTupleType *ASTType::getTupleTy(std::vector<ASTType *> t)
 {
-    // TODO: type cache
-    return new ASTTupleType(t);
+    static std::map<std::vector<ASTType*>, ASTTupleType*> tupleTypes;
+
+    llvm::sys::ScopedLock guard(getTypeLock());
+    ASTTupleType *&tupty = tupleTypes[t];
+    if(!tupty) {
+        tupty = new ASTTupleType(t);
+    }
+    return tupty;
 }
 
 ASTFunctionType *ASTType::getFunctionTy(ASTType *ret, std::vector<ASTType *> param, bool vararg)
 {
-    //TODO: type cache?
-    return new ASTFunctionType(ret, param, vararg);
+    typedef std::pair<std::vector<ASTType*>, bool> FunctionKey; // return and parameter types, vararg
+    static std::map<FunctionKey, ASTFunctionType*> functionTypes;
+
+    FunctionKey key(std::vector<ASTType*>(1, ret), vararg);
+    key.first.insert(key.first.end(), param.begin(), param.end());
+
+    llvm::sys::ScopedLock guard(getTypeLock());
+    ASTFunctionType *&fty = functionTypes[key];
+    if(!fty) {
+        fty = new ASTFunctionType(ret, param, vararg);
+    }
+    return fty;
 }
 
 ASTType *ASTType::getVoidFunctionTy() {
@@ -533,6 +607,7 @@ ASTUserType *ASTUserType::asUnion() {
 }
 
 bool ASTUserType::is(ASTType *t) {
+    if(this == t) return true;
     if(t->isUserType()) {
         return getDeclaration() == t->getDeclaration();
     }
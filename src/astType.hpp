@@ -2,6 +2,7 @@
 #define _ASTTYPE_HPP
 
 #include <sstream>
+#include <vector>
 
 class ASTVisitor;
 
@@ -51,6 +52,32 @@ struct ASTArrayType;
 struct ASTStaticArrayType;
 struct ASTDynamicArrayType;
 
+struct ASTType;
+
+/**
+ * memory layout of an aggregate (struct, union, class or tuple), in bytes.
+ * built once, the first time it is needed; member types must be resolved by then.
+ * 'padding' counts the bytes no member uses, between members and at the end
+ */
+struct TypeLayout
+{
+    bool done;
+    size_t size;
+    size_t align;
+    size_t padding;
+    std::vector<size_t> offsets; // of each member, from the start of the aggregate
+
+    TypeLayout() : done(false), size(0), align(1), padding(0) {}
+
+    // places 'sz' bytes after what is already laid out, returns their offset
+    size_t place(size_t sz, size_t al, bool packed = false);
+    void addMember(ASTType *ty, bool packed = false);
+    void addOverlappingMember(ASTType *ty); // union member, at offset 0
+    void finish(bool packed = false); // pads the size to a multiple of the alignment
+
+    static size_t storageSize(ASTType *ty); // bytes a member of type 'ty' takes
+};
+
 //XXX probably should not have llvm type/debug info in ASTType
 #include <llvm/IR/Type.h>
 #if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 5
@@ -68,6 +95,10 @@ struct ASTDynamicArrayType;
  * NOTE: not unique! more than one ASTType may refer to the same typeDeclaration.
  * This mostly happens if a type is used across modules or in forward declarations and uses.
  * For a unique representation of a type, use TypeDeclaration
+ *
+ * Derived types (pointer, constant size array, const, tuple, function) are unique for their
+ * element types, so two derived types built from the same element types are the
+ * same object. They may still be distinct but equal through distinct user types.
  */
 struct ASTType
 {
@@ -284,6 +315,7 @@ struct ASTFunctionType : public ASTCompositeType {
     virtual bool coercesTo(ASTType *t);
 
     virtual bool is(ASTType *t) {
+        if(this == t) return true;
         if(ASTFunctionType *oth = dynamic_cast<ASTFunctionType*>(t)) {
             if(!getReturnType()->is(oth->getReturnType()) ||
                     params.size() != oth->params.size()) return false;
@@ -396,6 +428,8 @@ struct ASTUserType : public ASTCompositeType {
 
 struct ASTTupleType : public ASTCompositeType {
     std::vector<ASTType*> types;
+    TypeLayout layout;
+    const TypeLayout &getLayout();
     virtual ASTTupleType *asTuple() { return this; }
     virtual ASTType *getMemberType(size_t i) { return types[i]; }
     virtual size_t length() { return types.size(); }
@@ -427,6 +461,7 @@ struct ASTTupleType : public ASTCompositeType {
     }
 
     virtual bool is(ASTType *t) {
+        if(this == t) return true;
         if(ASTTupleType *oth = dynamic_cast<ASTTupleType*>(t)) {
             if(types.size() == oth->types.size()) {
                 for(int i = 0; i < types.size(); i++) {
@@ -453,6 +488,7 @@ struct ASTPointerType : public ASTType {
     virtual std::string getName();
     virtual std::string getMangledName();
     virtual bool is(ASTType *t) {
+        if(this == t) return true;
         if(ASTPointerType *oth = dynamic_cast<ASTPointerType*>(t)) {
             return ptrTo->is(oth->ptrTo);
         }
@@ -0,0 +1,185 @@
+#include "bufferLexer.hpp"
+#include "lexScan.hpp"
+#include "message.hpp"
+#include "file.hpp"
+
+#include <string.h>
+#include <stdlib.h>
+#include <ctype.h>
+
+#include <fstream>
+
+#ifndef WIN32
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+BufferLexer::BufferLexer(std::string filenm) : begin(NULL), end(NULL), cur(NULL),
+    lineStart(NULL), mapped(false), mappedSize(0)
+{
+#ifndef WIN32
+    int fd = open(filenm.c_str(), O_RDONLY);
+    if(fd < 0) return;
+
+    struct stat st;
+    if(fstat(fd, &st) == 0 && st.st_size > 0)
+    {
+        void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(data != MAP_FAILED)
+        {
+            begin = (const char*) data;
+            end = begin + st.st_size;
+            mapped = true;
+            mappedSize = st.st_size;
+        }
+    }
+
+    if(!mapped) // empty, or not mappable (eg. a pipe); read it instead
+    {
+        std::string contents;
+        char buf[65536];
+        ssize_t n;
+        while((n = read(fd, buf, sizeof(buf))) > 0)
+        {
+            contents.append(buf, n);
+        }
+
+        char *data = (char*) malloc(contents.length() + 1);
+        memcpy(data, contents.data(), contents.length());
+        begin = data;
+        end = begin + contents.length();
+    }
+    close(fd);
+#else
+    std::ifstream stream(filenm.c_str(), std::ios::in | std::ios::binary);
+    if(!stream) return;
+
+    std::string contents((std::istreambuf_iterator<char>(stream)), std::istreambuf_iterator<char>());
+    char *data = (char*) malloc(contents.length() + 1);
+    memcpy(data, contents.data(), contents.length());
+    begin = data;
+    end = begin + contents.length();
+#endif
+
+    cur = lineStart = begin;
+    advance();
+}
+
+BufferLexer::~BufferLexer()
+{
+#ifndef WIN32
+    if(mapped)
+    {
+        munmap((void*) begin, mappedSize);
+        return;
+    }
+#endif
+    free((void*) begin);
+}
+
+uint64_t BufferLexer::contentHash()
+{
+    return hashBytes(HASH_SEED, begin, end - begin);
+}
+
+/*
+ * a run of digits that is a whole decimal integer. anything the generic
+ * lexNumber handles differently (0x, 0o, 0b prefixes, fractions, '_'
+ * separators, the 'f' suffix) is left to it. returns false if nothing was
+ * lexed
+ */
+bool BufferLexer::lexDecimal()
+{
+    const char *start = cur;
+    const char *digits = scanDigits(cur, end);
+
+    if(digits < end)
+    {
+        char next = *digits;
+        if(next == '.' || next == '_' || next == 'f') return false;
+        if(digits - start == 1 && *start == '0' &&
+                (tolower(next) == 'x' || tolower(next) == 'o' || tolower(next) == 'b')) return false;
+    }
+
+    cur = digits;
+    current = Token(tok::intNum, std::string(start, digits - start));
+    return true;
+}
+
+void BufferLexer::scanLineComment()
+{
+    const char *nl = (const char*) memchr(cur, '\n', end - cur);
+    cur = nl ? nl : end;
+}
+
+bool BufferLexer::advance()
+{
+    if(!begin)
+    {
+        current = Token(tok::eof);
+        return false;
+    }
+
+    const char *before = cur;
+
+    unsigned newlines = 0;
+    const char *lastNewline = NULL;
+    cur = scanWhitespace(cur, end, &newlines, &lastNewline);
+    bool ws = newlines > 0;
+    if(newlines)
+    {
+        line += newlines;
+        lineStart = lastNewline + 1;
+    }
+
+    SourceLocation loc(filenm, line, cur - lineStart + 1);
+    const char *start = cur;
+
+    if(cur < end && (isalpha((unsigned char) *cur) || *cur == '_'))
+    {
+        cur = scanIdentifier(cur + 1, end);
+        current = lexKeyword(start, cur - start);
+    } else if(cur + 1 < end && cur[0] == '/' && cur[1] == '/')
+    {
+        scanLineComment();
+        current = Token(tok::comment);
+    } else if(cur + 1 < end && cur[0] == '/' && cur[1] == '*')
+    {
+        newlines = 0;
+        cur = scanBlockComment(cur + 2, end, &newlines, &lastNewline);
+        if(!cur)
+        {
+            emit_message(msg::ERROR, "unterminated block comment", loc);
+            cur = end;
+        }
+        if(newlines)
+        {
+            line += newlines;
+            lineStart = lastNewline + 1;
+        }
+        current = Token(tok::comment);
+    } else if(cur < end && isdigit((unsigned char) *cur) && lexDecimal())
+    {
+        // plain decimal integer; current is set
+    } else
+    {
+        unsigned startLine = line;
+        current = getTok();
+
+        // strings may span lines
+        if(line != startLine)
+        {
+            lineStart = cur;
+            while(lineStart > begin && lineStart[-1] != '\n') lineStart--;
+        }
+    }
+
+    current.newline = ws;
+    current.loc = loc;
+    current.setLength(cur - before);
+    if(current.kind == tok::none || current.kind == tok::eof) return false;
+    return true;
+}
@@ -0,0 +1,67 @@
+#ifndef _BUFFERLEXER_HPP
+#define _BUFFERLEXER_HPP
+
+#include <string>
+#include <stdio.h>
+
+#include "token.hpp"
+#include "lexer.hpp"
+
+/*
+ * lexes a whole source file held in memory (mapped, where possible).
+ * whitespace, identifiers, keywords, comments and decimal integers are
+ * scanned directly with the (vectorized) kernels in lexScan.hpp; other
+ * tokens use the generic Lexer routines on top of the same buffer.
+ * token lengths and columns are pointer offsets
+ */
+class BufferLexer : public Lexer
+{
+    const char *begin;
+    const char *end;
+    const char *cur;
+    const char *lineStart; // first character of the current line
+    bool mapped;
+    size_t mappedSize;
+
+    void scanLineComment();
+    bool lexDecimal();
+
+    public:
+    BufferLexer(std::string filenm);
+    virtual ~BufferLexer();
+
+    // false if the file could not be read
+    bool isValid() { return begin != NULL; }
+
+    // hash of the content being lexed (see hashSourceFile)
+    uint64_t contentHash();
+
+    virtual int peekChar()
+    {
+        return cur < end ? (unsigned char) *cur : EOF;
+    }
+
+    virtual void ignoreChar()
+    {
+        if(cur < end) cur++;
+    }
+
+    virtual int getChar()
+    {
+        return cur < end ? (unsigned char) *cur++ : EOF;
+    }
+
+    virtual bool eofChar()
+    {
+        return cur >= end;
+    }
+
+    virtual bool advance();
+
+    virtual SourceLocation getLocation()
+    {
+        return SourceLocation(filenm, line, cur - lineStart + 1);
+    }
+};
+
+#endif
@@ -8,23 +8,48 @@ struct WLConfig
     std::string cmd;
     std::string output; //output file
     std::vector<std::string> files;
+    std::vector<std::string> objects; // object files and libraries passed to the linker
+    std::vector<std::string> bitcode; // LLVM bitcode (or textual IR) linked into the program
     std::vector<std::string> lib; // -l
     std::vector<std::string> inc; // -i
     std::vector<std::string> libdirs; // -L
     std::vector<std::string> incdirs; // -I
     std::vector<std::string> frameworks; // -f (OSX ONLY)
+    std::vector<std::string> runArgs; // arguments after '--', passed to main with --run
 
     std::string tempName;
+    std::string cacheDir; // -fcache, -fcache-dir=<dir>; bitcode and module interfaces. empty if disabled
+    std::string socketPath; // --server=<path>
+    std::string timeTrace; // -ftime-trace=<file>
 
     bool link;
     bool debug;
     bool emitllvm;
+    bool serve; // --server
+    bool timeReport; // -ftime-report
+    bool saveTemps; // --save-temps
+    bool lto; // -flto
+    bool lazyParse; // -flazy-parse
+    bool reorderFields; // on unless -fno-reorder-fields
+    bool run; // --run
+
+    int optLevel; // -O<n>
+    int jobs; // -j <n>; parsing threads, and codegen processes
 
     WLConfig()
     {
         link = true;
         debug = false;
         emitllvm = false;
+        serve = false;
+        timeReport = false;
+        saveTemps = false;
+        lto = false;
+        lazyParse = false;
+        reorderFields = true; // class layout is not part of any C interface
+        run = false;
+        optLevel = 0;
+        jobs = 1;
 
 		// if not on windows link with C and Math libraries, by default
 #ifndef WIN32
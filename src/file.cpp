@@ -4,6 +4,11 @@
 #include <string.h>
 #include <sys/stat.h>
 
+#ifdef WIN32
+#include <direct.h>
+#define mkdir(path, mode) _mkdir(path)
+#endif
+
 #if defined WIN32
 const char *builtinInclude = "C:/Program Files/WLC/include/;C:/INSTALL/WLC/include/";
 #else
@@ -59,3 +64,38 @@ std::string findFile(std::string filenm) {
 
     return filenm; //cannot find
 }
+
+// mkdir -p
+bool makeDirectory(std::string dir) {
+    for(size_t i = 1; i <= dir.length(); i++) {
+        if(i == dir.length() || dir[i] == '/') {
+            std::string sub = dir.substr(0, i);
+            struct stat st;
+            if(stat(sub.c_str(), &st) != 0 && mkdir(sub.c_str(), 0755) != 0) {
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+uint64_t hashBytes(uint64_t h, const char *bytes, size_t len) {
+    for(size_t i = 0; i < len; i++) {
+        h ^= (unsigned char) bytes[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+bool hashSourceFile(std::string path, uint64_t &h) {
+    std::ifstream stream(path.c_str(), std::ios::in | std::ios::binary);
+    if(!stream) return false;
+
+    h = HASH_SEED;
+    char buf[4096];
+    while(stream) {
+        stream.read(buf, sizeof(buf));
+        h = hashBytes(h, buf, stream.gcount());
+    }
+    return true;
+}
@@ -1,7 +1,19 @@
+#ifndef _FILE_HPP
+#define _FILE_HPP
+
+#include <stdint.h>
 #include <fstream>
 #include <iostream>
 
 std::string findFile(std::string filenm);
+bool fileExists(std::string filenm);
+bool makeDirectory(std::string dir); // creates missing parents too
+
+// FNV-1a. sources are compared by content hash; size and mtime can stay
+// the same across an edit
+#define HASH_SEED 14695981039346656037ULL
+uint64_t hashBytes(uint64_t h, const char *bytes, size_t len);
+bool hashSourceFile(std::string path, uint64_t &h); // false if it can't be read
 
 class File {
     std::string filename;
@@ -23,3 +35,5 @@ class File {
         return !stream.fail();
     }
 };
+
+#endif
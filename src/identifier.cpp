@@ -3,7 +3,7 @@
 
 #include <assert.h>
 
-Identifier::Identifier(ASTScope *ta, std::string s, IDType t) :
+Identifier::Identifier(ASTScope *ta, InternedString s, IDType t) :
     table(ta), kind(t), name(s), declaration(NULL), astValue(NULL), ref(NULL), isMangled(false), expression(0), astType(NULL)
 {
     mangled = "";
@@ -15,7 +15,7 @@ void Identifier::addDeclaration(Declaration *decl, IDType ty)
     FunctionDeclaration *fdecl = dynamic_cast<FunctionDeclaration*>(decl);
     if(fdecl && fdeclaration){
         if(fdecl->getType()->is(fdeclaration->getType())) {
-            if(fdecl->body && fdeclaration->body) {
+            if(fdecl->hasBody() && fdeclaration->hasBody()) {
                 emit_message(msg::ERROR, "redeclaration of function with identical parameters", decl->loc);
             }
             return;
@@ -27,12 +27,19 @@ void Identifier::addDeclaration(Declaration *decl, IDType ty)
 
     // if already declared, but not a function; or if a function with a body and new decl is
     // not a function; then there is a conflict
-    if((!fdeclaration && declaration) || (fdeclaration && fdeclaration->body)){
+    if((!fdeclaration && declaration) || (fdeclaration && fdeclaration->hasBody())){
         emit_message(msg::FATAL, "redefinition of " + getName() +
                 " originally defined at " + declaration->loc.toString(), decl->loc);
     }
     declaration = decl;
-    kind = ty;
+    setKind(ty);
+}
+
+void Identifier::setKind(IDType t)
+{
+    // a declared identifier may shadow what lookups found before
+    if(kind == ID_UNKNOWN && t != ID_UNKNOWN && table) table->symbolsChanged();
+    kind = t;
 }
 
 ASTType *Identifier::getType()
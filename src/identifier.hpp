@@ -3,6 +3,9 @@
 #define _IDENTIFIER_HPP
 
 #include <string>
+#include "intern.hpp"
+#include "arena.hpp"
+
 struct Declaration;
 struct Expression;
 struct ASTType;
@@ -31,7 +34,7 @@ struct Identifier
 
     bool isMangled;
     IDType kind;
-    std::string name;
+    InternedString name;
     std::string mangled; // mangled base name (without parameter/return qualifier)
     Declaration *declaration;
     Expression *expression;
@@ -44,13 +47,16 @@ struct Identifier
     };
     ASTType *astType;
 
-    Identifier(ASTScope *ta, std::string s, IDType t = ID_UNKNOWN);
+    ARENA_ALLOCATED(Identifier)
+
+    Identifier(ASTScope *ta, InternedString s, IDType t = ID_UNKNOWN);
     void addDeclaration(Declaration *decl, IDType t = ID_UNKNOWN);
-    void setKind(IDType t) { kind = t; }
+    void setKind(IDType t);
     Declaration *getDeclaration();
-    void setExpression(Expression *e) { expression = e; kind = ID_EXPRESSION; }
+    void setExpression(Expression *e) { expression = e; setKind(ID_EXPRESSION); }
     Expression *getExpression() { return expression; }
-    std::string getName() { return name; }
+    std::string getName() { return *name; }
+    InternedString getInternedName() { return name; }
     std::string getMangledName();
     ASTType *getType();
     ASTType *getDeclaredType();
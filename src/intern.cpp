@@ -0,0 +1,49 @@
+#include "intern.hpp"
+
+#include <llvm/ADT/StringMap.h>
+#include <llvm/Support/Mutex.h>
+
+using namespace llvm;
+
+// function statics, so interning works from other static initializers
+static StringMap<std::string*> &getStrings()
+{
+    static StringMap<std::string*> strings;
+    return strings;
+}
+
+static sys::Mutex &getLock()
+{
+    static sys::Mutex lock;
+    return lock;
+}
+
+static size_t &getBytes()
+{
+    static size_t bytes = 0;
+    return bytes;
+}
+
+InternedString intern(const char *str, size_t len)
+{
+    sys::ScopedLock guard(getLock());
+
+    std::string *&interned = getStrings()[StringRef(str, len)];
+    if(!interned)
+    {
+        interned = new std::string(str, len);
+        getBytes() += sizeof(StringMapEntry<std::string*>) + sizeof(std::string) + 2 * len;
+    }
+    return interned;
+}
+
+InternedString intern(const std::string &str)
+{
+    return intern(str.data(), str.length());
+}
+
+size_t internedBytes()
+{
+    sys::ScopedLock guard(getLock());
+    return getBytes();
+}
@@ -0,0 +1,35 @@
+#ifndef _INTERN_HPP
+#define _INTERN_HPP
+
+#include <string>
+#include <stddef.h>
+
+/*
+ * global string interner. every distinct string is stored once, for the
+ * life of the process; equal strings intern to the same pointer, so
+ * interned strings can be compared (and hashed) by address.
+ * safe to call from several threads.
+ *
+ * nothing is ever dropped, not even when the AST that used a string is
+ * freed. a compile is short lived, but the compile server keeps parsing;
+ * it restarts itself once the interner holds too much (see server.cpp)
+ */
+
+typedef const std::string *InternedString;
+
+InternedString intern(const char *str, size_t len);
+InternedString intern(const std::string &str);
+
+// approximate memory held by interned strings, in bytes
+size_t internedBytes();
+
+// orders interned strings by their contents (eg. for deterministic iteration)
+struct InternedLess
+{
+    bool operator()(InternedString a, InternedString b) const
+    {
+        return a != b && *a < *b;
+    }
+};
+
+#endif
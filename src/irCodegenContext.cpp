@@ -1,6 +1,11 @@
 #include "ast.hpp"
 #include "token.hpp"
 #include "irCodegenContext.hpp"
+#include "irOptimize.hpp"
+#include "irTarget.hpp"
+#include "irJIT.hpp"
+#include "file.hpp"
+#include "timing.hpp"
 
 #if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 5
 #define LLVM_35
@@ -19,6 +24,7 @@
 
 #include <fstream>
 #include <iostream>
+#include <sstream>
 #include <stdio.h>
 
 using namespace std;
@@ -2100,8 +2106,8 @@ ASTValue *IRCodegenContext::promotePointer(ASTValue *val, ASTType *toType) {
 
     if(toType->isInteger())
     {
-        return new ASTBasicValue(toType, ir->CreateIntCast(codegenValue(val),
-                    codegenType(toType), false));
+        return new ASTBasicValue(toType, ir->CreatePtrToInt(codegenValue(val),
+                    codegenType(toType)));
     }
 
     if(toType->isReference()) {
@@ -3027,20 +3033,162 @@ void printModule(Module *m, std::string filenm) {
 #error invalid LLVM version
 #endif
 
+/*
+ * where --save-temps writes a module's IR, in the current directory. named
+ * after the module's path (other/util.wl -> other-util.ll), so modules with
+ * the same file name in different directories don't overwrite each other
+ */
+std::string IRCodegenContext::dumpName(ModuleDeclaration *mdecl)
+{
+    std::string path = mdecl->filenm;
+    size_t lastDot = path.find_last_of(".");
+    size_t lastSlash = path.find_last_of("/\\");
+    if(lastDot != std::string::npos && (lastSlash == std::string::npos || lastDot > lastSlash))
+        path = path.substr(0, lastDot);
+
+    std::string name;
+    size_t start = 0;
+    while(start <= path.length())
+    {
+        size_t end = path.find_first_of("/\\", start);
+        if(end == std::string::npos) end = path.length();
+        std::string part = path.substr(start, end - start);
+        if(!part.empty() && part != "." && part != "..")
+            name += (name.empty() ? "" : "-") + part;
+        start = end + 1;
+    }
+
+    // paths that differ only in '.', '..' or separators still get their own file
+    std::string dump = name + ".ll";
+    for(int n = 2; dumpNames.count(dump); n++)
+    {
+        std::stringstream ss;
+        ss << name << "." << n << ".ll";
+        dump = ss.str();
+    }
+    dumpNames.insert(dump);
+    return dump;
+}
+
+/*
+ * links a module's IR into the output module. with --save-temps, the
+ * module is also written as textual IR to the current directory
+ */
+void IRCodegenContext::linkModule(ModuleDeclaration *mdecl, Module *m)
+{
+    std::string err;
+    if(config.saveTemps)
+    {
+        printModule(m, dumpName(mdecl));
+    }
+
+    linker.linkInModule(m, (unsigned) Linker::DestroySource, &err);
+}
+
+/*
+ * links bitcode given on the command line (eg. C helpers built with
+ * 'clang -emit-llvm -c') into the output module, so that it is optimized
+ * along with the OWL code
+ */
+void IRCodegenContext::linkBitcodeInputs()
+{
+    for(int i = 0; i < config.bitcode.size(); i++)
+    {
+        Module *m = readIRFile(config.bitcode[i], context);
+        if(!m) continue;
+
+        std::string err;
+        if(linker.linkInModule(m, (unsigned) Linker::DestroySource, &err))
+        {
+            emit_message(msg::ERROR, "unable to link '" + config.bitcode[i] + "': " + err);
+        }
+        delete m;
+    }
+}
+
+// absolute path with the extension removed: lib/util.wl -> /home/me/lib/util
+static std::string absoluteFilebase(std::string path)
+{
+    char buf[PATH_MAX];
+    if(realpath(path.c_str(), buf)) path = buf;
+
+    size_t lastDot = path.find_last_of(".");
+    size_t lastSlash = path.find_last_of("/\\");
+    if(lastDot != std::string::npos && (lastSlash == std::string::npos || lastDot > lastSlash))
+        path = path.substr(0, lastDot);
+    return path;
+}
+
+/*
+ * when linking, an imported module whose object was given on the command
+ * line is not generated again. the object must be the one -c writes for it
+ * (util.o in the current directory) or sit beside its source (lib/util.o for
+ * lib/util.wl); an unrelated other/util.o does not count.
+ */
+bool IRCodegenContext::isLinkedFromObject(AST *ast, WLConfig &config, ModuleDeclaration *mdecl)
+{
+    if(!config.link || mdecl->expl ||
+            mdecl == ast->getRuntimeModule() || mdecl == ast->getCModule())
+    {
+        return false;
+    }
+
+    std::string source = absoluteFilebase(findFile(mdecl->filenm));
+    std::string compiled = absoluteFilebase(getFilebase(mdecl->filenm) + ".o");
+    for(int i = 0; i < config.objects.size(); i++)
+    {
+        std::string object = absoluteFilebase(config.objects[i]);
+        if(object == source || object == compiled) return true;
+    }
+
+    return false;
+}
+
+/*
+ * bodies are only left unparsed in modules whose bitcode was found in the
+ * cache (see parseNeededBodies in main.cpp). if that bitcode can't be read
+ * after all, the module can't be generated in this compile; the bad entry
+ * is dropped so the next compile parses and generates it
+ */
+bool IRCodegenContext::lostCachedBitcode(ModuleDeclaration *mdecl)
+{
+    if(mdecl->lazyFunctions.empty()) return false;
+
+    if(cache) cache->discard(mdecl);
+    emit_message(msg::ERROR, "cached bitcode of module '" + mdecl->getName() +
+            "' could not be read, compile again");
+    return true;
+}
+
 void IRCodegenContext::codegenPackage(PackageDeclaration *p)
 {
     if(p->moduleDeclaration()) // leaf in package tree
     {
-        std::string err;
+        if(isLinkedFromObject(ast, config, p->moduleDeclaration())) return;
+
+        TimeScope timer("codegen", p->moduleDeclaration()->getName());
+        if(cache)
+        {
+            if(Module *cached = cache->load(p->moduleDeclaration(), context))
+            {
+                linkModule(p->moduleDeclaration(), cached);
+                delete cached;
+                return;
+            }
+        }
+
+        if(lostCachedBitcode(p->moduleDeclaration())) return;
+
         IRTranslationUnit *unit = new IRTranslationUnit(this, p->moduleDeclaration());
         //p->cgValue = 0;
         codegenTranslationUnit(unit);
 
-        // XXX debug, output all modules
-        std::string outputll = config.tempName + "/" + unit->mdecl->getName() + ".ll";
-        printModule(unit->llvmModule, outputll);
+        if(cache && currentErrorLevel() <= msg::WARNING)
+        {
+            cache->store(unit->mdecl, unit->llvmModule);
+        }
 
-        linker.linkInModule(unit->llvmModule, (unsigned) Linker::DestroySource, &err);
+        linkModule(unit->mdecl, unit->llvmModule);
 
     } else // generate all leaves ...
     {
@@ -3055,6 +3203,131 @@ void IRCodegenContext::codegenPackage(PackageDeclaration *p)
 #ifdef WIN32
 #else
 #include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#endif
+
+static void collectModules(PackageDeclaration *p, std::vector<ModuleDeclaration*> &modules)
+{
+    if(p->moduleDeclaration())
+    {
+        modules.push_back(p->moduleDeclaration());
+    } else
+    {
+        for(int i = 0; i < p->children.size(); i++)
+        {
+            collectModules(p->children[i], modules);
+        }
+    }
+}
+
+#ifdef WIN32
+void IRCodegenContext::codegenPackageParallel(PackageDeclaration *p)
+{
+    emit_message(msg::WARNING, "parallel code generation is not supported on this platform");
+    codegenPackage(p);
+}
+#else
+/*
+ * the AST caches codegen results (types, values, debug info) as it is
+ * generated, so modules cannot safely be generated on threads sharing it.
+ * instead each worker is a forked copy of the compiler with its own
+ * LLVMContext and its own copy of those caches. worker 'n' generates every
+ * 'jobs'th module and writes it out as bitcode; once all workers finish,
+ * the bitcode is linked in package order, same as codegenPackage.
+ */
+void IRCodegenContext::codegenPackageParallel(PackageDeclaration *p)
+{
+    TimeScope timer("codegen", "parallel");
+    std::vector<ModuleDeclaration*> all;
+    std::vector<ModuleDeclaration*> modules;
+    collectModules(p, all);
+    for(int i = 0; i < all.size(); i++)
+    {
+        if(!isLinkedFromObject(ast, config, all[i])) modules.push_back(all[i]);
+    }
+
+    // modules found in the cache are linked straight from it,
+    // only the rest are handed to the workers
+    std::vector<std::string> bitcode;
+    std::vector<int> pending;
+    for(int i = 0; i < modules.size(); i++)
+    {
+        if(cache && fileExists(cache->getPath(modules[i])))
+        {
+            bitcode.push_back(cache->getPath(modules[i]));
+        } else
+        {
+            if(lostCachedBitcode(modules[i])) return;
+
+            std::stringstream ss;
+            ss << config.tempName << "/module" << i << ".bc";
+            bitcode.push_back(ss.str());
+            pending.push_back(i);
+        }
+    }
+
+    int jobs = config.jobs;
+    if(jobs > pending.size()) jobs = pending.size();
+
+    // don't let the workers inherit (and repeat) unflushed output
+    cout.flush();
+    fflush(NULL);
+
+    std::vector<pid_t> workers;
+    for(int w = 0; w < jobs; w++)
+    {
+        pid_t pid = fork();
+        if(pid < 0)
+        {
+            emit_message(msg::ERROR, "unable to start code generation worker");
+            break;
+        }
+
+        if(pid == 0)
+        {
+            for(int j = w; j < pending.size(); j += jobs)
+            {
+                int i = pending[j];
+                IRTranslationUnit *unit = new IRTranslationUnit(this, modules[i]);
+                codegenTranslationUnit(unit);
+                if(currentErrorLevel() > msg::WARNING) break;
+                writeBitcodeFile(unit->llvmModule, bitcode[i]);
+                if(cache) cache->store(modules[i], unit->llvmModule);
+            }
+            cout.flush();
+
+            // never return to main; the parent owns the temp directory
+            _exit(currentErrorLevel() > msg::WARNING ? 1 : 0);
+        }
+
+        workers.push_back(pid);
+    }
+
+    bool failed = workers.size() != jobs;
+    for(int i = 0; i < workers.size(); i++)
+    {
+        int status;
+        if(waitpid(workers[i], &status, 0) < 0 || !WIFEXITED(status) || WEXITSTATUS(status))
+        {
+            failed = true;
+        }
+    }
+
+    if(failed)
+    {
+        emit_message(msg::ERROR, "code generation failed");
+        return;
+    }
+
+    for(int i = 0; i < modules.size(); i++)
+    {
+        Module *m = readIRFile(bitcode[i], context);
+        if(!m) return;
+        linkModule(modules[i], m);
+        delete m;
+    }
+}
 #endif
 
 #ifdef LLVM_35
@@ -3085,60 +3358,153 @@ bool checkModule(Module *m) {
 }
 #endif
 
-std::string IRCodegenContext::codegenAST(AST *ast, WLConfig config)
+/*
+ * -c: each explicitly requested module becomes its own object file,
+ * named after the source (foo.wl -> foo.o) or -o if there is only one.
+ * imported modules are only declared; their code comes from their own
+ * objects, and the runtime is generated by the final link step
+ */
+void IRCodegenContext::codegenObjects(PackageDeclaration *root)
 {
-    this->ast = ast;
-    this->config = config;
-    codegenPackage(ast->getRootPackage());
-    if(currentErrorLevel() > msg::WARNING)
+    std::vector<ModuleDeclaration*> all;
+    std::vector<ModuleDeclaration*> modules;
+    collectModules(root, all);
+    for(int i = 0; i < all.size(); i++)
     {
-        emit_message(msg::OUTPUT, "compilation ended with errors");
-        return "";
+        if(all[i]->expl) modules.push_back(all[i]);
     }
 
-    createIdentMetadata(linker.getModule());
+    if(!config.output.empty() && modules.size() > 1)
+    {
+        emit_message(msg::ERROR, "cannot specify -o with -c and multiple files");
+        return;
+    }
 
-    checkModule(linker.getModule());
+    TargetMachine *tm = createHostTargetMachine(config);
+    if(!tm) return;
 
-    std::string err;
-    std::string outputll;
-    std::string outputo;
+    for(int i = 0; i < modules.size(); i++)
+    {
+        ModuleDeclaration *mdecl = modules[i];
+        std::string outputo = config.output.empty() ? getFilebase(mdecl->filenm) + ".o" : config.output;
 
-    if(config.emitllvm)
+        Module *m = NULL;
+        {
+            TimeScope timer("codegen", mdecl->getName());
+            if(cache) m = cache->load(mdecl, context);
+            if(!m)
+            {
+                if(lostCachedBitcode(mdecl)) break;
+                IRTranslationUnit *unit = new IRTranslationUnit(this, mdecl);
+                codegenTranslationUnit(unit);
+                if(currentErrorLevel() > msg::WARNING) break;
+                if(cache) cache->store(mdecl, unit->llvmModule);
+                m = unit->llvmModule;
+            }
+        }
+
+        if(config.saveTemps)
+        {
+            printModule(m, dumpName(mdecl));
+        }
+
+        createIdentMetadata(m);
+        checkModule(m);
+        setModuleTarget(m, tm);
+
+        {
+            TimeScope timer("optimize", mdecl->getName());
+            optimizeModule(m, tm, config);
+        }
+
+        TimeScope timer("emit", mdecl->getName());
+        if(!emitObjectFile(m, tm, outputo)) break;
+    }
+
+    delete tm;
+}
+
+std::string IRCodegenContext::codegenAST(AST *ast, WLConfig config)
+{
+    this->ast = ast;
+    this->config = config;
+    if(!config.cacheDir.empty())
     {
-        outputll = "output.ll";
-    } else
+        cache = new ModuleCache(config.cacheDir, ast, config);
+    }
+
+    if(!config.link && !config.emitllvm)
     {
-        outputll = config.tempName + "output.ll";
+        if(config.lto || config.bitcode.size())
+        {
+            emit_message(msg::WARNING, "-flto and bitcode inputs only apply when linking, ignored with -c");
+        }
+        codegenObjects(ast->getRootPackage());
+        return "";
     }
 
-    if(config.link)
+    if(config.jobs > 1)
     {
-        outputo = config.tempName + "output.o";
+        codegenPackageParallel(ast->getRootPackage());
     } else
     {
-        outputo = "output.o";
+        codegenPackage(ast->getRootPackage());
+    }
+    linkBitcodeInputs();
+    if(currentErrorLevel() > msg::WARNING)
+    {
+        emit_message(msg::OUTPUT, "compilation ended with errors");
+        return "";
     }
 
-    printModule(linker.getModule(), outputll);
+    createIdentMetadata(linker.getModule());
+
+    checkModule(linker.getModule());
 
-    std::string llccmd = "llc " + outputll + " --filetype=obj -O0 -o " + outputo;
+    TargetMachine *tm = createHostTargetMachine(config);
+    if(!tm) return "";
+    setModuleTarget(linker.getModule(), tm);
 
-    if(!config.emitllvm)
     {
-        int syserr = system(llccmd.c_str());
-        if(syserr)
+        TimeScope timer("optimize");
+        if(config.lto)
         {
-            emit_message(msg::FATAL, std::string("system command failed...") + llccmd.c_str());
+            optimizeModuleLTO(linker.getModule(), tm, config);
+        } else
+        {
+            optimizeModule(linker.getModule(), tm, config);
         }
-    } else
+    }
+
+    if(config.run)
     {
+        // the linked module is run in-process by runProgram
+        delete tm;
         return "";
     }
 
+    TimeScope timer("emit");
+    if(config.emitllvm)
+    {
+        printModule(linker.getModule(), "output.ll");
+        delete tm;
+        return "";
+    }
+
+    std::string outputo = config.tempName + "output.o";
+    bool emitted = emitObjectFile(linker.getModule(), tm, outputo);
+    delete tm;
+
+    if(!emitted) return "";
     return outputo;
 }
 
+int IRCodegenContext::runProgram()
+{
+    TimeScope timer("run");
+    return runModule(linker.getModule(), config);
+}
+
 void IRCodegen(AST *ast, WLConfig config)
 {
     IRCodegenContext context;
@@ -22,8 +22,10 @@
 #endif
 
 #include <stack>
+#include <set>
 
 #include "irDebug.hpp"
+#include "moduleCache.hpp"
 
 struct IRCodegenContext;
 
@@ -159,14 +161,23 @@ class IRCodegenContext : public CodegenContext
     AST *ast;
     bool terminated;
     WLConfig config;
+    ModuleCache *cache;
+    std::set<std::string> dumpNames; // --save-temps files written so far
 
     IRCodegenContext() : context(llvm::getGlobalContext()),
     ir(new llvm::IRBuilder<>(context)),
-     module(NULL), linker(new llvm::Module("", context)), terminated(false), ast(0) {}
+     module(NULL), linker(new llvm::Module("", context)), terminated(false), ast(0), cache(0) {}
 
     llvm::LLVMContext& getLLVMContext() { return context; }
 
     std::string codegenAST(AST *ast, WLConfig param);
+
+    // --run: JIT and run the module built by codegenAST, returns main's result
+    int runProgram();
+
+    // when linking, an imported module whose object was given on the command
+    // line is not generated again
+    static bool isLinkedFromObject(AST *ast, WLConfig &config, ModuleDeclaration *mdecl);
     protected:
 
     bool isTerminated() { return terminated; }
@@ -332,7 +343,13 @@ class IRCodegenContext : public CodegenContext
     // codegen etc
     void codegenTranslationUnit(IRTranslationUnit *unit);
     void codegenInclude(IRTranslationUnit *current, ModuleDeclaration *inc);
+    void linkModule(ModuleDeclaration *mdecl, llvm::Module *m);
+    void linkBitcodeInputs();
     void codegenPackage(PackageDeclaration *p);
+    void codegenPackageParallel(PackageDeclaration *p);
+    void codegenObjects(PackageDeclaration *root);
+    bool lostCachedBitcode(ModuleDeclaration *mdecl);
+    std::string dumpName(ModuleDeclaration *mdecl);
 };
 
 #endif
@@ -98,13 +98,11 @@ llvm::DICompositeType IRDebug::createTupleType(ASTType *ty)
     assert(tupty && "expected tuple");
 
     vector<Value *> vec;
-    int offset = 0;
+    const TypeLayout &layout = tupty->getLayout();
     for(int i = 0; i < tupty->types.size(); i++)
     {
         unsigned size = tupty->types[i]->getSize();
         unsigned align = tupty->types[i]->getAlign();
-        if(offset % align)
-            offset += (align - (offset % align));
         stringstream ss;
         ss << i;
         vec.push_back(di.createMemberType(
@@ -114,10 +112,9 @@ llvm::DICompositeType IRDebug::createTupleType(ASTType *ty)
                     0, //TODO line num
                     size * 8,
                     align * 8,
-                    offset * 8,
+                    layout.offsets[i] * 8,
                     0,
                     createType(tupty->types[i])));
-        offset += tupty->types[i]->getSize();
         //TODO: members
     }
 
@@ -180,15 +177,12 @@ llvm::DICompositeType IRDebug::createStructType(ASTType *ty)
     llvm::DIDescriptor DIContext(currentFile());
     ASTUserType *userty = (ASTUserType*) ty;
     vector<Value *> vec;
-    int offset = 0;
     for(int i = 0; i < userty->length(); i++)
     {
         VariableDeclaration *vdecl = dynamic_cast<VariableDeclaration*>(userty->getMember(i));
         assert(vdecl);
         unsigned size = vdecl->getType()->getSize();
         unsigned align = vdecl->getType()->getAlign();
-        if(offset % align)
-            offset += (align - (offset % align));
         vec.push_back(di.createMemberType(
                     DIContext,
                     vdecl->getName(),
@@ -196,10 +190,9 @@ llvm::DICompositeType IRDebug::createStructType(ASTType *ty)
                     userty->getMember(i)->loc.line,
                     size * 8,
                     align * 8,
-                    offset * 8,
+                    userty->getMemberOffset(i) * 8,
                     0,
                     createType(vdecl->getType())));
-        offset += vdecl->getType()->getSize();
         //TODO: members
     }
 
@@ -271,15 +264,12 @@ llvm::DIType IRDebug::createClassType(ASTType *ty)
                 userty->getDeclaration()->loc.line, 8 * 8, 8 * 8, 8 * 8, 0,
                 createType(ASTType::getLongTy())));
 
-    int offset = 16;
     for(int i = 0; i < userty->length(); i++)
     {
         VariableDeclaration *vdecl = dynamic_cast<VariableDeclaration*>(userty->getMember(i));
         assert(vdecl);
         unsigned size = vdecl->getType()->getSize();
         unsigned align = vdecl->getType()->getAlign();
-        if(offset % align)
-            offset += (align - (offset % align));
         vec.push_back(di.createMemberType(
                     DIContext,
                     vdecl->getName(),
@@ -287,10 +277,9 @@ llvm::DIType IRDebug::createClassType(ASTType *ty)
                     userty->getDeclaration()->loc.line,
                     size * 8,
                     align * 8,
-                    offset * 8,
+                    userty->getMemberOffset(i) * 8,
                     0,
                     createType(vdecl->getType())));
-        offset += vdecl->getType()->getSize();
         //TODO: members
     }
 
@@ -435,10 +424,16 @@ llvm::DIType IRDebug::createType(ASTType *ty)
             case TYPE_DYNAMIC_ARRAY:
                 return createDynamicArrayType(ty);
             case TYPE_TUPLE:
-                dity = createTupleType(ty);
-                break;
             case TYPE_FUNCTION:
-                dity = createPrototype(ty);
+                if(compositeTypeMap.count(ty)) {
+                    return compositeTypeMap[ty];
+                }
+
+                if(ty->isTuple())
+                    dity = createTupleType(ty);
+                else
+                    dity = createPrototype(ty);
+                compositeTypeMap[ty] = dity;
                 break;
             case TYPE_UNKNOWN: //XXX workaround
                 dity = di.createBasicType("void", 8, 8, dwarf::DW_ATE_address);
@@ -37,6 +37,9 @@ class IRDebug
         // index is mangled name
         std::map<std::string, llvm::DIType> typeMap;
 
+        // tuple and function types are unique, so are looked up by address
+        std::map<ASTType*, llvm::DIType> compositeTypeMap;
+
         IRDebug(IRCodegenContext *c, IRTranslationUnit *u);
 
         ~IRDebug()
@@ -0,0 +1,124 @@
+#include "irJIT.hpp"
+#include "message.hpp"
+#include "file.hpp"
+#include "irTarget.hpp"
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/Support/DynamicLibrary.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <vector>
+
+#ifndef WIN32
+extern char **environ;
+#endif
+
+using namespace llvm;
+
+#if defined(__APPLE__)
+#define SHLIB_EXT ".dylib"
+#elif defined(WIN32)
+#define SHLIB_EXT ".dll"
+#else
+#define SHLIB_EXT ".so"
+#endif
+
+static bool loadLibrary(std::string path) {
+    return !sys::DynamicLibrary::LoadLibraryPermanently(path.c_str());
+}
+
+static bool loadLibraries(WLConfig &config) {
+    // the compiler itself is searched first; it already has libc and libm
+    // (whose .so may be a linker script, which cannot be dlopen'd)
+    sys::DynamicLibrary::LoadLibraryPermanently(NULL);
+
+    for(int i = 0; i < config.lib.size(); i++) {
+        std::string name = config.lib[i];
+#ifndef WIN32
+        if(name == "c" || name == "m") continue;
+#endif
+        bool loaded = false;
+        for(int j = 0; j < config.libdirs.size() && !loaded; j++) {
+            std::string path = config.libdirs[j] + "/lib" + name + SHLIB_EXT;
+            if(fileExists(path)) loaded = loadLibrary(path);
+        }
+
+        if(!loaded) loaded = loadLibrary("lib" + name + SHLIB_EXT); // system search path
+        if(!loaded) {
+            emit_message(msg::ERROR, "unable to load library '-l" + name + "' for --run");
+            return false;
+        }
+    }
+
+    for(int i = 0; i < config.objects.size(); i++) {
+        std::string obj = config.objects[i];
+        std::string ext = obj.substr(obj.find_last_of(".") + 1);
+        if(ext != "so" && ext != "dylib") {
+            emit_message(msg::ERROR, "'" + obj + "' cannot be used with --run, only shared libraries can be loaded");
+            return false;
+        }
+
+        if(!loadLibrary(obj)) {
+            emit_message(msg::ERROR, "unable to load '" + obj + "'");
+            return false;
+        }
+    }
+
+    return true;
+}
+
+int runModule(Module *m, WLConfig &config) {
+    InitializeNativeTarget();
+    InitializeNativeTargetAsmPrinter();
+    InitializeNativeTargetAsmParser();
+
+    if(!loadLibraries(config)) return -1;
+
+    Function *mainFunc = m->getFunction("main");
+    if(!mainFunc || mainFunc->isDeclaration()) {
+        emit_message(msg::ERROR, "no main function to run");
+        return -1;
+    }
+
+    std::string err;
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 6
+    EngineBuilder builder((std::unique_ptr<Module>(m)));
+    builder.setMCJITMemoryManager(std::unique_ptr<RTDyldMemoryManager>(new SectionMemoryManager()));
+#else
+    EngineBuilder builder(m);
+    builder.setUseMCJIT(true);
+    builder.setMCJITMemoryManager(new SectionMemoryManager());
+#endif
+    builder.setEngineKind(EngineKind::JIT);
+    builder.setErrorStr(&err);
+    builder.setOptLevel(getCodeGenOptLevel(config.optLevel));
+
+    ExecutionEngine *engine = builder.create();
+    if(!engine) {
+        emit_message(msg::ERROR, "unable to create JIT: " + err);
+        return -1;
+    }
+
+    engine->finalizeObject();
+    engine->runStaticConstructorsDestructors(false);
+
+    // argv[0] is the source, like the name of a script
+    std::vector<std::string> args;
+    args.push_back(config.files.size() ? config.files[0] : "a.out");
+    args.insert(args.end(), config.runArgs.begin(), config.runArgs.end());
+
+#ifdef WIN32
+    const char *envp[] = { NULL };
+    int ret = engine->runFunctionAsMain(mainFunc, args, envp);
+#else
+    int ret = engine->runFunctionAsMain(mainFunc, args, environ);
+#endif
+
+    engine->runStaticConstructorsDestructors(true);
+    engine->removeModule(m); // the caller owns the module
+    delete engine;
+
+    return ret;
+}
@@ -0,0 +1,18 @@
+#ifndef _IRJIT_HPP
+#define _IRJIT_HPP
+
+#include <llvm/IR/Module.h>
+
+#include "config.hpp"
+
+/*
+ * --run: JIT compiles a linked module in-process and calls its main with
+ * config.runArgs. external symbols resolve from the compiler process and
+ * from the shared libraries named with -l (searched for in the -L
+ * directories, then the system paths) and on the command line.
+ * returns main's return value, or -1 (after emitting an error) if the
+ * module could not be run. 'm' stays owned by the caller
+ */
+int runModule(llvm::Module *m, WLConfig &config);
+
+#endif
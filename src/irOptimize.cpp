@@ -0,0 +1,81 @@
+#include "irOptimize.hpp"
+#include "irTarget.hpp"
+
+#include <llvm/PassManager.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+
+using namespace llvm;
+
+void optimizeModule(Module *m, TargetMachine *tm, WLConfig &config) {
+    if(config.optLevel <= 0) return;
+
+    PassManagerBuilder builder;
+    builder.OptLevel = config.optLevel;
+    builder.SizeLevel = 0;
+
+    // -O1 only inlines functions explicitly marked always inline,
+    // like clang does
+    if(config.optLevel > 1) {
+        builder.Inliner = createFunctionInliningPass(config.optLevel, 0);
+    } else {
+        builder.Inliner = createAlwaysInlinerPass();
+    }
+
+    builder.DisableUnrollLoops = config.optLevel < 2;
+    builder.LoopVectorize = config.optLevel > 1;
+    builder.SLPVectorize = config.optLevel > 1;
+
+    // per-function cleanup (mem2reg, SROA, early CSE) first,
+    // then the interprocedural and loop passes over the whole module
+    FunctionPassManager fpm(m);
+    addDataLayoutPass(fpm, m);
+    if(tm) tm->addAnalysisPasses(fpm);
+    builder.populateFunctionPassManager(fpm);
+
+    PassManager mpm;
+    addDataLayoutPass(mpm, m);
+    if(tm) tm->addAnalysisPasses(mpm);
+    builder.populateModulePassManager(mpm);
+
+    fpm.doInitialization();
+    for(Module::iterator it = m->begin(); it != m->end(); it++) {
+        fpm.run(*it);
+    }
+    fpm.doFinalization();
+
+    mpm.run(*m);
+}
+
+void optimizeModuleLTO(Module *m, TargetMachine *tm, WLConfig &config) {
+    // the usual per-module pipeline first, so the LTO passes see
+    // simplified functions
+    optimizeModule(m, tm, config);
+
+    PassManagerBuilder builder;
+    builder.OptLevel = config.optLevel > 0 ? config.optLevel : 2;
+    builder.SizeLevel = 0;
+    builder.LoopVectorize = true;
+    builder.SLPVectorize = true;
+
+    PassManager pm;
+    addDataLayoutPass(pm, m);
+    if(tm) tm->addAnalysisPasses(pm);
+
+    // only main needs to be visible from outside the program. if objects
+    // built separately are linked in, they may refer to anything, so
+    // nothing can be internalized
+    if(config.objects.empty()) {
+        const char *exported[] = { "main" };
+        pm.add(createInternalizePass(ArrayRef<const char*>(exported)));
+    }
+
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 6
+    builder.Inliner = createFunctionInliningPass(builder.OptLevel, 0);
+    builder.populateLTOPassManager(pm);
+#else
+    builder.populateLTOPassManager(pm, false, true);
+#endif
+
+    pm.run(*m);
+}
@@ -0,0 +1,25 @@
+#ifndef _IROPTIMIZE_HPP
+#define _IROPTIMIZE_HPP
+
+#include <llvm/IR/Module.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include "config.hpp"
+
+/*
+ * runs the LLVM optimization pipeline over a (linked) module.
+ * the pipeline is selected by config.optLevel (-O0 to -O3);
+ * -O0 leaves the module untouched. if a target machine is given,
+ * its cost model is used by the vectorizers and loop passes
+ */
+void optimizeModule(llvm::Module *m, llvm::TargetMachine *tm, WLConfig &config);
+
+/*
+ * -flto: optimizes the module as a whole program. after the regular
+ * pipeline, everything but main is internalized and the LTO pipeline
+ * (IPSCCP, global DCE, cross module inlining, ...) is run. without an
+ * explicit -O, the LTO passes run as at -O2
+ */
+void optimizeModuleLTO(llvm::Module *m, llvm::TargetMachine *tm, WLConfig &config);
+
+#endif
@@ -0,0 +1,142 @@
+#include "irTarget.hpp"
+#include "message.hpp"
+
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IRReader/IRReader.h>
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/Support/SourceMgr.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetOptions.h>
+
+using namespace llvm;
+
+CodeGenOpt::Level getCodeGenOptLevel(int optLevel) {
+    switch(optLevel) {
+        case 0: return CodeGenOpt::None;
+        case 1: return CodeGenOpt::Less;
+        case 2: return CodeGenOpt::Default;
+        default: return CodeGenOpt::Aggressive;
+    }
+}
+
+TargetMachine *createHostTargetMachine(WLConfig &config) {
+    static bool initialized = false;
+    if(!initialized) {
+        InitializeNativeTarget();
+        InitializeNativeTargetAsmPrinter();
+        initialized = true;
+    }
+
+    std::string err;
+    std::string triple = sys::getDefaultTargetTriple();
+    const Target *target = TargetRegistry::lookupTarget(triple, err);
+    if(!target) {
+        emit_message(msg::ERROR, "unable to find target for '" + triple + "': " + err);
+        return NULL;
+    }
+
+    TargetOptions options;
+    TargetMachine *tm = target->createTargetMachine(triple, sys::getHostCPUName(), "",
+            options, Reloc::Default, CodeModel::Default, getCodeGenOptLevel(config.optLevel));
+    if(!tm) {
+        emit_message(msg::ERROR, "unable to create target machine for '" + triple + "'");
+    }
+
+    return tm;
+}
+
+void setModuleTarget(Module *m, TargetMachine *tm) {
+    m->setTargetTriple(tm->getTargetTriple());
+    m->setDataLayout(tm->getDataLayout()->getStringRepresentation());
+}
+
+void addDataLayoutPass(PassManagerBase &pm, Module *m) {
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 6
+    pm.add(new DataLayoutPass());
+#elif LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 5
+    pm.add(new DataLayoutPass(m));
+#elif LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR <= 4
+    pm.add(new DataLayout(m));
+#endif
+}
+
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 6
+static bool openOutput(raw_fd_ostream *&out, std::string filenm, std::string &err) {
+    std::error_code ec;
+    out = new raw_fd_ostream(filenm.c_str(), ec, sys::fs::F_None);
+    err = ec.message();
+    return !ec;
+}
+#elif LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 5
+static bool openOutput(raw_fd_ostream *&out, std::string filenm, std::string &err) {
+    out = new raw_fd_ostream(filenm.c_str(), err, sys::fs::F_None);
+    return err.empty();
+}
+#elif LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 4
+static bool openOutput(raw_fd_ostream *&out, std::string filenm, std::string &err) {
+    out = new raw_fd_ostream(filenm.c_str(), err, sys::fs::F_Binary);
+    return err.empty();
+}
+#else
+#error invalid LLVM version
+#endif
+
+bool emitObjectFile(Module *m, TargetMachine *tm, std::string filenm) {
+    std::string err;
+    raw_fd_ostream *out;
+    if(!openOutput(out, filenm, err)) {
+        emit_message(msg::ERROR, "unable to open '" + filenm + "' for writing: " + err);
+        delete out;
+        return false;
+    }
+
+    PassManager pm;
+    addDataLayoutPass(pm, m);
+    tm->addAnalysisPasses(pm);
+
+    bool ok = true;
+    { // formatted stream must be flushed before the file is closed
+        formatted_raw_ostream fout(*out);
+        if(tm->addPassesToEmitFile(pm, fout, TargetMachine::CGFT_ObjectFile)) {
+            emit_message(msg::ERROR, "target cannot emit object files");
+            ok = false;
+        } else {
+            pm.run(*m);
+        }
+    }
+
+    delete out;
+    return ok;
+}
+
+bool writeBitcodeFile(Module *m, std::string filenm) {
+    std::string err;
+    raw_fd_ostream *out;
+    if(!openOutput(out, filenm, err)) {
+        emit_message(msg::ERROR, "unable to open '" + filenm + "' for writing: " + err);
+        delete out;
+        return false;
+    }
+
+    WriteBitcodeToFile(m, *out);
+    delete out;
+    return true;
+}
+
+Module *readIRFile(std::string filenm, LLVMContext &context) {
+    SMDiagnostic diag;
+#if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 6
+    Module *m = parseIRFile(filenm, diag, context).release();
+#else
+    Module *m = ParseIRFile(filenm, diag, context);
+#endif
+    if(!m) {
+        emit_message(msg::ERROR, "unable to read '" + filenm + "': " + diag.getMessage().str());
+    }
+    return m;
+}
@@ -0,0 +1,37 @@
+#ifndef _IRTARGET_HPP
+#define _IRTARGET_HPP
+
+#include <llvm/IR/Module.h>
+#include <llvm/PassManager.h>
+#include <llvm/Target/TargetMachine.h>
+
+#include <string>
+
+#include "config.hpp"
+
+/*
+ * creates a target machine for the host; code generation optimization
+ * follows config.optLevel. returns NULL (and emits an error) if the host
+ * target is not available in this build of LLVM
+ */
+llvm::TargetMachine *createHostTargetMachine(WLConfig &config);
+
+// the code generator optimization level matching -O<n>
+llvm::CodeGenOpt::Level getCodeGenOptLevel(int optLevel);
+
+// sets the module's triple and data layout to match the target machine
+void setModuleTarget(llvm::Module *m, llvm::TargetMachine *tm);
+
+// adds the data layout of 'm' to a pass manager (required by most passes)
+void addDataLayoutPass(llvm::PassManagerBase &pm, llvm::Module *m);
+
+// writes 'm' as a native object file, returns false on failure
+bool emitObjectFile(llvm::Module *m, llvm::TargetMachine *tm, std::string filenm);
+
+// writes 'm' as LLVM bitcode, returns false on failure
+bool writeBitcodeFile(llvm::Module *m, std::string filenm);
+
+// reads an LLVM bitcode or textual IR file, returns NULL on failure
+llvm::Module *readIRFile(std::string filenm, llvm::LLVMContext &context);
+
+#endif
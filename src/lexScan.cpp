@@ -0,0 +1,346 @@
+#include "lexScan.hpp"
+
+#include <stddef.h>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define LEXSCAN_X86
+#include <immintrin.h>
+#endif
+
+/*
+ * scalar kernels. also used for the tail of the buffer, where there are
+ * too few bytes left for a vector load
+ */
+
+static inline bool isSpaceChar(unsigned char c)
+{
+    return c == ' ' || (c >= '\t' && c <= '\r');
+}
+
+static inline bool isIdentChar(unsigned char c)
+{
+    return (c >= '0' && c <= '9') || ((c | 0x20) >= 'a' && (c | 0x20) <= 'z') || c == '_';
+}
+
+static const char *scanWhitespaceScalar(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    for(; p < end && isSpaceChar(*p); p++)
+    {
+        if(*p == '\n')
+        {
+            (*newlines)++;
+            *lastNewline = p;
+        }
+    }
+    return p;
+}
+
+static const char *scanBlockCommentScalar(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    for(; p < end; p++)
+    {
+        if(*p == '\n')
+        {
+            (*newlines)++;
+            *lastNewline = p;
+        } else if(*p == '*' && p + 1 < end && p[1] == '/')
+        {
+            return p + 2;
+        }
+    }
+    return NULL;
+}
+
+static const char *scanIdentifierScalar(const char *p, const char *end)
+{
+    while(p < end && isIdentChar(*p)) p++;
+    return p;
+}
+
+static const char *scanDigitsScalar(const char *p, const char *end)
+{
+    while(p < end && *p >= '0' && *p <= '9') p++;
+    return p;
+}
+
+#ifdef LEXSCAN_X86
+
+// adds the newlines in 'mask' (one bit per byte from 'base')
+static inline void countNewlines(unsigned mask, const char *base,
+        unsigned *newlines, const char **lastNewline)
+{
+    if(mask)
+    {
+        *newlines += __builtin_popcount(mask);
+        *lastNewline = base + (31 - __builtin_clz(mask));
+    }
+}
+
+// bits below the first set bit of 'stop' (which must be non zero)
+static inline unsigned before(unsigned stop)
+{
+    return (1u << __builtin_ctz(stop)) - 1;
+}
+
+/*
+ * SSE2, 16 bytes at a time.
+ * SSE2 only has signed byte compares; a range [lo, hi] is tested by
+ * moving lo to -128 and comparing below -128 + (hi - lo + 1)
+ */
+
+#define SSE_RANGE(v, lo, hi) _mm_cmplt_epi8(_mm_add_epi8((v), _mm_set1_epi8((char) (0x80 - (lo)))), \
+        _mm_set1_epi8((char) (0x80 + (hi) - (lo) + 1)))
+
+__attribute__((target("sse2")))
+static inline unsigned spaceMask16(__m128i v)
+{
+    __m128i sp = _mm_or_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8(' ')), SSE_RANGE(v, '\t', '\r'));
+    return _mm_movemask_epi8(sp);
+}
+
+__attribute__((target("sse2")))
+static inline unsigned identMask16(__m128i v)
+{
+    __m128i lower = _mm_or_si128(v, _mm_set1_epi8(0x20));
+    __m128i m = _mm_or_si128(SSE_RANGE(lower, 'a', 'z'), SSE_RANGE(v, '0', '9'));
+    m = _mm_or_si128(m, _mm_cmpeq_epi8(v, _mm_set1_epi8('_')));
+    return _mm_movemask_epi8(m);
+}
+
+__attribute__((target("sse2")))
+static const char *scanWhitespaceSSE2(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        unsigned nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned stop = ~spaceMask16(v) & 0xffff;
+        if(stop)
+        {
+            countNewlines(nl & before(stop), p, newlines, lastNewline);
+            return p + __builtin_ctz(stop);
+        }
+        countNewlines(nl, p, newlines, lastNewline);
+        p += 16;
+    }
+    return scanWhitespaceScalar(p, end, newlines, lastNewline);
+}
+
+__attribute__((target("sse2")))
+static const char *scanBlockCommentSSE2(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    // compares each byte and the one after it, so needs one byte spare
+    while(end - p >= 17)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        __m128i next = _mm_loadu_si128((const __m128i*) (p + 1));
+        unsigned nl = _mm_movemask_epi8(_mm_cmpeq_epi8(v, _mm_set1_epi8('\n')));
+        unsigned close = _mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(v, _mm_set1_epi8('*')),
+                    _mm_cmpeq_epi8(next, _mm_set1_epi8('/'))));
+        if(close)
+        {
+            countNewlines(nl & before(close), p, newlines, lastNewline);
+            return p + __builtin_ctz(close) + 2;
+        }
+        countNewlines(nl, p, newlines, lastNewline);
+        p += 16;
+    }
+    return scanBlockCommentScalar(p, end, newlines, lastNewline);
+}
+
+__attribute__((target("sse2")))
+static const char *scanIdentifierSSE2(const char *p, const char *end)
+{
+    while(end - p >= 16)
+    {
+        unsigned stop = ~identMask16(_mm_loadu_si128((const __m128i*) p)) & 0xffff;
+        if(stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanIdentifierScalar(p, end);
+}
+
+__attribute__((target("sse2")))
+static const char *scanDigitsSSE2(const char *p, const char *end)
+{
+    while(end - p >= 16)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i*) p);
+        unsigned stop = ~_mm_movemask_epi8(SSE_RANGE(v, '0', '9')) & 0xffff;
+        if(stop) return p + __builtin_ctz(stop);
+        p += 16;
+    }
+    return scanDigitsScalar(p, end);
+}
+
+/*
+ * AVX2, 32 bytes at a time
+ */
+
+#define AVX_RANGE(v, lo, hi) _mm256_cmpgt_epi8(_mm256_set1_epi8((char) (0x80 + (hi) - (lo) + 1)), \
+        _mm256_add_epi8((v), _mm256_set1_epi8((char) (0x80 - (lo)))))
+
+__attribute__((target("avx2")))
+static inline unsigned spaceMask32(__m256i v)
+{
+    __m256i sp = _mm256_or_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8(' ')), AVX_RANGE(v, '\t', '\r'));
+    return _mm256_movemask_epi8(sp);
+}
+
+__attribute__((target("avx2")))
+static inline unsigned identMask32(__m256i v)
+{
+    __m256i lower = _mm256_or_si256(v, _mm256_set1_epi8(0x20));
+    __m256i m = _mm256_or_si256(AVX_RANGE(lower, 'a', 'z'), AVX_RANGE(v, '0', '9'));
+    m = _mm256_or_si256(m, _mm256_cmpeq_epi8(v, _mm256_set1_epi8('_')));
+    return _mm256_movemask_epi8(m);
+}
+
+__attribute__((target("avx2")))
+static const char *scanWhitespaceAVX2(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    while(end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        unsigned nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        unsigned stop = ~spaceMask32(v);
+        if(stop)
+        {
+            countNewlines(nl & before(stop), p, newlines, lastNewline);
+            return p + __builtin_ctz(stop);
+        }
+        countNewlines(nl, p, newlines, lastNewline);
+        p += 32;
+    }
+    return scanWhitespaceSSE2(p, end, newlines, lastNewline);
+}
+
+__attribute__((target("avx2")))
+static const char *scanBlockCommentAVX2(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    while(end - p >= 33)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        __m256i next = _mm256_loadu_si256((const __m256i*) (p + 1));
+        unsigned nl = _mm256_movemask_epi8(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('\n')));
+        unsigned close = _mm256_movemask_epi8(_mm256_and_si256(_mm256_cmpeq_epi8(v, _mm256_set1_epi8('*')),
+                    _mm256_cmpeq_epi8(next, _mm256_set1_epi8('/'))));
+        if(close)
+        {
+            countNewlines(nl & before(close), p, newlines, lastNewline);
+            return p + __builtin_ctz(close) + 2;
+        }
+        countNewlines(nl, p, newlines, lastNewline);
+        p += 32;
+    }
+    return scanBlockCommentSSE2(p, end, newlines, lastNewline);
+}
+
+__attribute__((target("avx2")))
+static const char *scanIdentifierAVX2(const char *p, const char *end)
+{
+    while(end - p >= 32)
+    {
+        unsigned stop = ~identMask32(_mm256_loadu_si256((const __m256i*) p));
+        if(stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanIdentifierSSE2(p, end);
+}
+
+__attribute__((target("avx2")))
+static const char *scanDigitsAVX2(const char *p, const char *end)
+{
+    while(end - p >= 32)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i*) p);
+        unsigned stop = ~_mm256_movemask_epi8(AVX_RANGE(v, '0', '9'));
+        if(stop) return p + __builtin_ctz(stop);
+        p += 32;
+    }
+    return scanDigitsSSE2(p, end);
+}
+
+#endif // LEXSCAN_X86
+
+/*
+ * runtime dispatch
+ */
+
+struct ScanKernels
+{
+    ScanISA isa;
+    const char *(*whitespace)(const char*, const char*, unsigned*, const char**);
+    const char *(*blockComment)(const char*, const char*, unsigned*, const char**);
+    const char *(*identifier)(const char*, const char*);
+    const char *(*digits)(const char*, const char*);
+};
+
+static const ScanKernels scalarKernels = { SCAN_SCALAR,
+    scanWhitespaceScalar, scanBlockCommentScalar, scanIdentifierScalar, scanDigitsScalar };
+
+#ifdef LEXSCAN_X86
+static const ScanKernels sse2Kernels = { SCAN_SSE2,
+    scanWhitespaceSSE2, scanBlockCommentSSE2, scanIdentifierSSE2, scanDigitsSSE2 };
+static const ScanKernels avx2Kernels = { SCAN_AVX2,
+    scanWhitespaceAVX2, scanBlockCommentAVX2, scanIdentifierAVX2, scanDigitsAVX2 };
+#endif
+
+ScanISA bestScanISA()
+{
+#ifdef LEXSCAN_X86
+    __builtin_cpu_init();
+    if(__builtin_cpu_supports("avx2")) return SCAN_AVX2;
+    if(__builtin_cpu_supports("sse2")) return SCAN_SSE2;
+#endif
+    return SCAN_SCALAR;
+}
+
+static const ScanKernels *getKernels(ScanISA isa)
+{
+#ifdef LEXSCAN_X86
+    if(isa == SCAN_AVX2) return &avx2Kernels;
+    if(isa == SCAN_SSE2) return &sse2Kernels;
+#endif
+    return &scalarKernels;
+}
+
+static const ScanKernels *kernels = getKernels(bestScanISA());
+
+ScanISA currentScanISA()
+{
+    return kernels->isa;
+}
+
+void selectScanISA(ScanISA isa)
+{
+    kernels = getKernels(isa);
+}
+
+const char *scanWhitespace(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    return kernels->whitespace(p, end, newlines, lastNewline);
+}
+
+const char *scanBlockComment(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline)
+{
+    return kernels->blockComment(p, end, newlines, lastNewline);
+}
+
+const char *scanIdentifier(const char *p, const char *end)
+{
+    return kernels->identifier(p, end);
+}
+
+const char *scanDigits(const char *p, const char *end)
+{
+    return kernels->digits(p, end);
+}
@@ -0,0 +1,43 @@
+#ifndef _LEXSCAN_HPP
+#define _LEXSCAN_HPP
+
+/*
+ * scanning kernels for the buffer lexer.
+ *
+ * each returns a pointer to the first character at or after 'p' that is
+ * not part of the run (or 'end'). kernels that can cross lines add the
+ * newlines they pass to '*newlines' and point '*lastNewline' at the last
+ * one. the fastest implementation the CPU supports (AVX2, SSE2 or plain
+ * C) is picked at startup
+ */
+
+enum ScanISA
+{
+    SCAN_SCALAR,
+    SCAN_SSE2,
+    SCAN_AVX2,
+};
+
+// whitespace, as isspace() in the C locale
+const char *scanWhitespace(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline);
+
+// the body of a block comment; 'p' follows the opening '/*'. returns the
+// character after the closing '*/', or NULL if the comment is unterminated
+const char *scanBlockComment(const char *p, const char *end,
+        unsigned *newlines, const char **lastNewline);
+
+// [A-Za-z0-9_]
+const char *scanIdentifier(const char *p, const char *end);
+
+// [0-9]
+const char *scanDigits(const char *p, const char *end);
+
+// the best kernels this CPU supports, and the kernels in use
+ScanISA bestScanISA();
+ScanISA currentScanISA();
+
+// forces a kernel set (eg. to compare them); it must be supported
+void selectScanISA(ScanISA isa);
+
+#endif
@@ -2,10 +2,87 @@
 #include "lexer.hpp"
 
 #include <assert.h>
+#include <stdint.h>
+#include <string.h>
 #include <string>
 
 using namespace std;
 
+/*
+ * keyword recognition.
+ *
+ * the keyword table is generated from tokenkinds.def. at startup, a seed
+ * is searched for that hashes every keyword to its own slot, so a word is
+ * a keyword only if the one entry in its slot matches. words longer than
+ * any keyword are never hashed
+ */
+struct Keyword
+{
+    const char *name;
+    size_t length;
+    tok::TokenKind kind;
+};
+
+static const Keyword keywords[] = {
+#define KEYWORD(X) { #X, sizeof(#X) - 1, tok::kw_##X },
+#include "tokenkinds.def"
+};
+
+static const unsigned NKEYWORDS = sizeof(keywords) / sizeof(Keyword);
+static const unsigned KEYWORD_BITS = 8;
+static const unsigned KEYWORD_SLOTS = 1 << KEYWORD_BITS; // well above NKEYWORDS
+
+static inline uint32_t hashWord(uint32_t seed, const char *str, size_t len)
+{
+    uint32_t h = seed;
+    for(size_t i = 0; i < len; i++)
+    {
+        h ^= (unsigned char) str[i];
+        h *= 16777619; // FNV-1a prime
+    }
+    return h >> (32 - KEYWORD_BITS); // the high bits depend on every bit of the seed
+}
+
+struct KeywordTable
+{
+    uint32_t seed;
+    size_t maxLength;
+    const Keyword *slots[KEYWORD_SLOTS];
+
+    KeywordTable() : seed(2166136261U), maxLength(0)
+    {
+        for(unsigned i = 0; i < NKEYWORDS; i++)
+        {
+            if(keywords[i].length > maxLength) maxLength = keywords[i].length;
+        }
+
+        while(!tryBuild()) seed++;
+    }
+
+    bool tryBuild()
+    {
+        for(unsigned i = 0; i < KEYWORD_SLOTS; i++) slots[i] = NULL;
+
+        for(unsigned i = 0; i < NKEYWORDS; i++)
+        {
+            uint32_t h = hashWord(seed, keywords[i].name, keywords[i].length);
+            if(slots[h]) return false;
+            slots[h] = &keywords[i];
+        }
+        return true;
+    }
+
+    const Keyword *lookup(const char *str, size_t len) const
+    {
+        if(len > maxLength) return NULL;
+        const Keyword *kw = slots[hashWord(seed, str, len)];
+        if(kw && kw->length == len && !memcmp(kw->name, str, len)) return kw;
+        return NULL;
+    }
+};
+
+static const KeywordTable keywordTable;
+
 Token Lexer::lexWord()
 {
     char curChar;
@@ -15,16 +92,25 @@ Token Lexer::lexWord()
         tokstr += curChar;
     } while(isalnum(peekChar()) || peekChar() == '_');
 
-    if(tokstr == "and") return Token(tok::ampamp);
-    if(tokstr == "or") return Token(tok::barbar);
-    if(tokstr == "not") return Token(tok::bang);
+    return lexKeyword(tokstr.data(), tokstr.length());
+}
 
-#define KEYWORD(X) if(#X == tokstr) return Token(tok::kw_##X);
-#define RESERVED(X) if(#X == tokstr) emit_message(msg::ERROR, "keyword '" + tokstr + "' is reserved");
-#include "tokenkinds.def"
+// keyword or identifier token for a scanned word
+Token Lexer::lexKeyword(const char *str, size_t len)
+{
+    if(const Keyword *kw = keywordTable.lookup(str, len))
+    {
+        switch(kw->kind)
+        {
+            case tok::kw_and: return Token(tok::ampamp);
+            case tok::kw_or: return Token(tok::barbar);
+            case tok::kw_not: return Token(tok::bang);
+            default: return Token(kw->kind);
+        }
+    }
 
     // is identifier
-    return Token(tok::identifier, tokstr);
+    return Token(tok::identifier, intern(str, len));
 }
 
 // includes comments
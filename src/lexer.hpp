@@ -24,7 +24,8 @@ class Lexer
     public:
     virtual ~Lexer() {}
 
-    void setFilename(std::string str) { filenm = str.c_str(); }
+    // interned, so locations stay valid after the lexer is gone
+    void setFilename(std::string str) { filenm = intern(str)->c_str(); }
 
     virtual Token peek()
     {
@@ -57,6 +58,7 @@ class Lexer
     Token lex();
     Token getTok();
     Token lexWord();
+    Token lexKeyword(const char *str, size_t len);
     Token lexPunct();
     Token lexString();
     Token lexNumber();
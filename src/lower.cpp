@@ -109,7 +109,8 @@ void Lower::visitTupleExpression(TupleExpression *exp) {
  * else if RHS is a valid function name in scope, and it's first parameter matches LHS's type, we have (e)
  */
 void Lower::visitDotExpression(DotExpression *exp) {
-    exp->lhs = exp->lhs->lower();
+    // 'Type.member' in 'Type.member.offsetof' is not a static member lookup
+    if(exp->rhs != "offsetof") exp->lhs = exp->lhs->lower();
 }
 
 void Lower::visitNewExpression(NewExpression *exp) {
@@ -172,3 +173,13 @@ void Lower::visitReturnStatement(ReturnStatement *stmt) {
         stmt->expression = stmt->expression->lower();
     }
 }
+
+//
+// ReorderFields
+//
+
+void ReorderFields::visitUserTypeDeclaration(UserTypeDeclaration *decl) {
+    if(ClassDeclaration *cldecl = decl->classDeclaration()) {
+        cldecl->reorderMembers();
+    }
+}
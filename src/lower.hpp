@@ -35,4 +35,11 @@ class Lower : public ASTVisitor {
     virtual void visitSwitchStatement(SwitchStatement *exp);
 };
 
-
+/*
+ * sorts the fields of every class to minimize padding (unless -fno-reorder-fields).
+ * runs after validation and before lowering
+ */
+class ReorderFields : public ASTVisitor {
+    public:
+    virtual void visitUserTypeDeclaration(UserTypeDeclaration *decl);
+};
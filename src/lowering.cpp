@@ -55,6 +55,43 @@ Expression *UnaryExpression::lower() {
 }
 
 Expression *DotExpression::lower() {
+    // lower 'Type.member.offsetof' to constant int
+    if(rhs == "offsetof") {
+        DotExpression *member = lhs->dotExpression();
+        ASTUserType *uty = NULL;
+        if(member && member->lhs->isType()) {
+            uty = member->lhs->getDeclaredType()->asUserType();
+        }
+
+        if(!uty) {
+            emit_message(msg::ERROR, "invalid 'offsetof'; expected 'Type.member.offsetof' on user type", loc);
+            return this;
+        }
+
+        // base class members are at the same offset in derived classes
+        long index = uty->getMemberIndex(member->rhs);
+        if(uty->isUnion()) {
+            // a union's member index is always 0 (codegen casts the one storage member)
+            UserTypeDeclaration *udecl = uty->getDeclaration();
+            index = -1;
+            for(int i = 0; i < udecl->members.size(); i++) {
+                if(udecl->members[i]->identifier->getName() == member->rhs) index = i;
+            }
+        }
+        while(index < 0 && uty->isClass() && uty->getBaseType()) {
+            uty = uty->getBaseType()->asUserType();
+            index = uty->getMemberIndex(member->rhs);
+        }
+
+        if(index < 0) {
+            emit_message(msg::ERROR, "member '" + member->rhs + "' not found in type '" +
+                    member->lhs->getDeclaredType()->getName() + "'", loc);
+            return this;
+        }
+
+        return new IntExpression(ASTType::getLongTy(), uty->getMemberOffset(index));
+    }
+
     if(rhs == "ptr" && (lhs->getType()->isArray() || lhs->getType()->isInterface())) {
         return new DotPtrExpression(lhs, lhs->loc);
     }
@@ -65,15 +102,6 @@ Expression *DotExpression::lower() {
             return new IntExpression(ASTType::getLongTy(), lhs->getDeclaredType()->getSize());
         }
 
-        if(rhs == "offsetof") {
-            ASTUserType *uty = lhs->getDeclaredType()->asUserType();
-            if(uty) {
-                emit_message(msg::UNIMPLEMENTED, "unimplemented 'offsetof' operator", loc);
-            } else {
-                emit_message(msg::ERROR, "invalid 'offsetof' on non-user type", loc);
-            }
-        }
-
         //TODO: generalize to member lookup of package, namespace, etc
         // static member lookup?
         ASTType *declty = lhs->getDeclaredType();
@@ -5,6 +5,10 @@
 #include "irCodegenContext.hpp"
 #include "message.hpp"
 #include "config.hpp"
+#include "moduleCache.hpp"
+#include "server.hpp"
+#include "main.hpp"
+#include "timing.hpp"
 
 #ifdef WIN32
 #include "win_getopt.h"
@@ -20,7 +24,9 @@
 #include <ctype.h>
 
 #include <vector>
+#include <iostream>
 #include <string.h>
+#include <stdlib.h>
 
 #if LLVM_VERSION_MAJOR == 3 && LLVM_VERSION_MINOR >= 5
 #include <llvm/Linker/Linker.h>
@@ -66,6 +72,7 @@ static std::string createTempDir() {
 
 void link(WLConfig params, std::string outputo)
 {
+        TimeScope timer("link");
         std::string dynamiclinker = "/lib64/ld-linux-x86-64.so.2";
 
         std::string libdirstr = "";
@@ -94,7 +101,14 @@ void link(WLConfig params, std::string outputo)
             libstr += " -i" + params.inc[i];
         }
 
-        std::string linkcmd = "clang " + outputo + " " + libdirstr + incdirstr + libstr + incstr + " -o " + params.output;
+        std::string objstr = "";
+        for(int i = 0; i < params.objects.size(); i++)
+        {
+            objstr += " " + params.objects[i];
+        }
+
+        std::string output = params.output.empty() ? "a.out" : params.output;
+        std::string linkcmd = "clang " + outputo + objstr + " " + libdirstr + incdirstr + libstr + incstr + " -o " + output;
         int err = system(linkcmd.c_str());
         if(err)
         {
@@ -103,66 +117,226 @@ void link(WLConfig params, std::string outputo)
         }
 }
 
-void compile(WLConfig params)
+/*
+ * parses the runtime and every file on the command line into parser's AST.
+ * anything already in the AST (eg. a server's warm AST) is not parsed again
+ */
+void parseSources(Parser *parser, WLConfig &params)
 {
-    if(params.files.size())
-    {
-        Parser parser;
-        AST *ast = parser.getAST();
+    AST *ast = parser->getAST();
+    ArenaScope arena(ast->getArena());
+    parser->setJobs(params.jobs); // imports are parsed in parallel
+    parser->setLazyBodies(params.lazyParse);
+    parser->setInterfaceDir(params.cacheDir); // module interfaces are cached with the bitcode
 
+    if(!ast->getRuntimeModule())
+    {
         Identifier *rt_id = ast->getRootPackage()->getScope()->getInScope("runtime");
         ModuleDeclaration *runtime = new ModuleDeclaration(ast->getRootPackage(), rt_id, "runtime.wl");
         rt_id->addDeclaration(runtime, Identifier::ID_MODULE);
         ast->setRuntimeModule(runtime);
-        parser.parseFile(runtime, new File("runtime.wl"));
+        parser->parseFile(runtime, new File("runtime.wl"));
+    }
 
-        for(int i = 0; i < params.files.size(); i++)
+    for(int i = 0; i < params.files.size(); i++)
+    {
+        if(!ast->getModule(params.files[i])) // check if file already parsed
         {
-            if(!ast->getModule(params.files[i])) // check if file already parsed
-            {
-                Identifier *mod_id = ast->getRootPackage()->getScope()->getInScope(params.files[i]); //TODO: file basename
-                ModuleDeclaration *module = new ModuleDeclaration(ast->getRootPackage(), mod_id, params.files[i]);
-                mod_id->addDeclaration(module, Identifier::ID_MODULE);
-
-                module->expl = true;
-                ast->addModule(params.files[i], module);
-                parser.parseFile(module, new File(params.files[i]));
-            } else
-            {
-                ModuleDeclaration *mod = ast->getModule(params.files[i]);
-                mod->expl = true;
-            }
+            Identifier *mod_id = ast->getRootPackage()->getScope()->getInScope(params.files[i]); //TODO: file basename
+            ModuleDeclaration *module = new ModuleDeclaration(ast->getRootPackage(), mod_id, params.files[i]);
+            mod_id->addDeclaration(module, Identifier::ID_MODULE);
+
+            module->expl = true;
+            ast->addModule(params.files[i], module);
+            parser->parseFile(module, new File(params.files[i]));
+        } else
+        {
+            ModuleDeclaration *mod = ast->getModule(params.files[i]);
+            mod->expl = true;
+        }
+    }
+}
+
+// a module whose bitcode is cached is not generated, so its bodies are not
+// needed. unless one imports a module: that import is not in the cache key yet
+static bool hasCachedBitcode(ModuleCache *cache, ModuleDeclaration *mdecl)
+{
+    if(!cache) return false;
+
+    for(int i = 0; i < mdecl->lazyFunctions.size(); i++)
+    {
+        std::vector<Token> &tokens = mdecl->lazyFunctions[i]->lazyBody->tokens;
+        for(int j = 0; j < tokens.size(); j++)
+        {
+            if(tokens[j].is(tok::kw_import)) return false;
         }
+    }
+    return fileExists(cache->getPath(mdecl));
+}
 
-        if(!ast->validate()){
-            emit_message(msg::ERROR, "invalid AST");
-        } else {
+/*
+ * parses the function bodies skipped by -flazy-parse, for every module that
+ * gets code generated. with -c, imported modules are only declared, and
+ * modules found in the cache are linked from it.
+ * bodies are parsed even without -flazy-parse; a server's warm AST may
+ * have been parsed with it
+ */
+static void parseNeededBodies(AST *ast, WLConfig &params)
+{
+    ArenaScope arena(ast->getArena());
+    ModuleCache *cache = NULL;
+    if(!params.cacheDir.empty()) cache = new ModuleCache(params.cacheDir, ast, params);
 
-        IRCodegenContext cg;
-        std::string outputo = cg.codegenAST(ast, params);
+    // a body may import a module that was not seen before. that changes the
+    // cache keys of its importers, so every module is checked again
+    bool parsed = true;
+    while(parsed)
+    {
+        parsed = false;
+        std::map<std::string, ModuleDeclaration*>::iterator it;
+        for(it = ast->modules.begin(); it != ast->modules.end(); it++)
+        {
+            ModuleDeclaration *mdecl = it->second;
+            if(mdecl->lazyFunctions.empty()) continue;
+            if(!mdecl->expl && !params.link && !params.emitllvm) continue;
+            if(IRCodegenContext::isLinkedFromObject(ast, params, mdecl)) continue;
+            if(hasCachedBitcode(cache, mdecl)) continue;
 
-        // TODO: check if codegen succeeded before attempting to link
-        if(params.link && currentErrorLevel() < msg::ERROR)
-            link(params, outputo);
+            parseLazyBodies(mdecl);
+            parsed = true;
         }
+    }
+
+    delete cache;
+}
+
+/*
+ * returns the exit status of the program for --run, otherwise 0.
+ * compile errors are reported through the error level
+ */
+int compileAST(AST *ast, WLConfig &params)
+{
+    int status = 0;
+    parseNeededBodies(ast, params);
+    ast->setReorderFields(params.reorderFields);
+    if(!ast->validate()){
+        emit_message(msg::ERROR, "invalid AST");
+    } else {
+
+    IRCodegenContext cg;
+    std::string outputo = cg.codegenAST(ast, params);
+
+    // TODO: check if codegen succeeded before attempting to link
+    if(params.run && currentErrorLevel() < msg::ERROR)
+        status = cg.runProgram();
+    else if(params.link && currentErrorLevel() < msg::ERROR)
+        link(params, outputo);
+    }
+
+    if(params.timeReport)
+        printTimeReport(std::cerr);
+
+    if(!params.timeTrace.empty())
+        writeTimeTrace(params.timeTrace);
+
+    return status;
+}
+
+int compile(WLConfig params)
+{
+    if(params.timeReport || !params.timeTrace.empty()) enableTiming();
+
+    // objects alone can still be linked; the runtime is always compiled in
+    if(params.files.size() || (params.link && (params.objects.size() || params.bitcode.size())))
+    {
+        Parser parser;
+        parseSources(&parser, params);
+        return compileAST(parser.getAST(), params);
     } else
     {
         emit_message(msg::FATAL, "no input files");
     }
+    return 0;
+}
+
+// objects and libraries go straight to the linker, bitcode is linked into
+// the generated module, anything else is OWL source
+static void addInputFile(WLConfig &params, std::string filenm)
+{
+    std::string ext = filenm.substr(filenm.find_last_of(".") + 1);
+    if(filenm.find('.') != std::string::npos &&
+            (ext == "o" || ext == "obj" || ext == "a" || ext == "so" || ext == "lib" || ext == "dylib"))
+    {
+        params.objects.push_back(filenm);
+    } else if(filenm.find('.') != std::string::npos && (ext == "bc" || ext == "ll"))
+    {
+        params.bitcode.push_back(filenm);
+    } else
+    {
+        params.files.push_back(filenm);
+    }
+}
+
+static void parseLongOption(WLConfig &params, std::string opt)
+{
+    std::string name = opt.substr(0, opt.find('='));
+    std::string value = opt.find('=') != std::string::npos ? opt.substr(opt.find('=') + 1) : "";
+
+    if(name == "--server")
+    {
+        params.serve = true;
+        params.socketPath = value.empty() ? defaultSocketPath() : value;
+    } else if(name == "--run")
+    {
+        params.run = true;
+    } else if(name == "--save-temps")
+    {
+        params.saveTemps = true;
+    } else if(name == "--connect")
+    {
+        // handled in main; only seen here if the server could not be reached
+    } else
+    {
+        emit_message(msg::ERROR, "unrecognized command line option '" + opt + "'");
+    }
 }
 
+// only fills in the config; timing is enabled by whoever compiles with it.
+// the server parses the arguments of every request it warms
 WLConfig parseCmd(int argc, char **argv)
 {
     WLConfig params;
     params.cmd = std::string(argv[0]);
     params.files = std::vector<std::string>();
 	params.tempName = createTempDir();
-    params.output = "a.out"; // default output string
+    params.output = ""; // default output: a.out, or <file>.o for each file with -c
+
+    // parseCmd may be run more than once per process (server mode),
+    // so getopt needs to be reset
+#ifdef __GLIBC__
+    optind = 0;
+#else
+    optind = 1;
+#endif
 
     int c;
     while(optind < argc)
     {
-        c = getopt(argc, argv, "-gcSl:L:I:o:");
+        // everything after '--' belongs to the program run with --run
+        if(optind > 0 && !strcmp(argv[optind], "--"))
+        {
+            params.runArgs.insert(params.runArgs.end(), argv + optind + 1, argv + argc);
+            break;
+        }
+
+        if(optind > 0 && !strncmp(argv[optind], "--", 2) && argv[optind][2])
+        {
+            parseLongOption(params, argv[optind]);
+            optind++;
+            continue;
+        }
+
+        c = getopt(argc, argv, "-gcSl:L:I:o:O:j:f:");
         switch(c)
         {
             case 'g':
@@ -189,13 +363,52 @@ WLConfig parseCmd(int argc, char **argv)
             case 'o':
                 params.output = std::string(optarg);
                 break;
-#ifdef __APPLE__
-            case 'f':
-                params.frameworks.push_back(optarg);
+            case 'O':
+                if(strlen(optarg) != 1 || optarg[0] < '0' || optarg[0] > '3') {
+                    emit_message(msg::ERROR, std::string("invalid optimization level '-O") +
+                            std::string(optarg) + std::string("'"));
+                    break;
+                }
+                params.optLevel = optarg[0] - '0';
+                break;
+            case 'j':
+                params.jobs = atoi(optarg);
+                if(params.jobs < 1) {
+                    emit_message(msg::ERROR, std::string("invalid job count '-j ") +
+                            std::string(optarg) + std::string("'"));
+                }
                 break;
+            case 'f':
+                if(!strcmp(optarg, "cache")) {
+                    params.cacheDir = ModuleCache::defaultDirectory();
+                    if(params.cacheDir.empty()) {
+                        emit_message(msg::ERROR, "no cache directory found, set WLCACHE or use -fcache-dir=<dir>");
+                    }
+                } else if(!strncmp(optarg, "cache-dir=", 10)) {
+                    params.cacheDir = std::string(optarg + 10);
+                } else if(!strcmp(optarg, "lto")) {
+                    params.lto = true;
+                } else if(!strcmp(optarg, "lazy-parse")) {
+                    params.lazyParse = true;
+                } else if(!strcmp(optarg, "reorder-fields")) {
+                    params.reorderFields = true;
+                } else if(!strcmp(optarg, "no-reorder-fields")) {
+                    params.reorderFields = false;
+                } else if(!strcmp(optarg, "time-report")) {
+                    params.timeReport = true;
+                } else if(!strncmp(optarg, "time-trace=", 11)) {
+                    params.timeTrace = std::string(optarg + 11);
+                } else {
+#ifdef __APPLE__
+                    params.frameworks.push_back(optarg);
+#else
+                    emit_message(msg::ERROR, std::string("unrecognized command line option '-f") +
+                            std::string(optarg) + std::string("'"));
 #endif
+                }
+                break;
             case '?':
-                if(optopt == 'l' || optopt == 'L' || optopt == 'I')
+                if(optopt == 'l' || optopt == 'L' || optopt == 'I' || optopt == 'O' || optopt == 'j')
                 {
                     emit_message(msg::FATAL, std::string("missing argument to '-") +
                             std::string((char*) &optopt, 1) + std::string("'"));
@@ -204,12 +417,12 @@ WLConfig parseCmd(int argc, char **argv)
             default:
 #ifdef __APPLE__
             if(isalnum(argv[optind][0])) {
-                params.files.push_back(argv[optind]);
+                addInputFile(params, argv[optind]);
                 optind++; //apples getopt is weird in that it kills itself if a non-option is found (eg a filename to compile)
             }
 #else
             if(isalnum(argv[optind-1][0])) {
-                params.files.push_back(argv[optind-1]);
+                addInputFile(params, argv[optind-1]);
             }
 #endif
             // this is some argument that we cant deal with
@@ -220,6 +433,17 @@ WLConfig parseCmd(int argc, char **argv)
             }
         }
     }
+
+    if(params.run && !params.link)
+    {
+        emit_message(msg::ERROR, "--run cannot be used with -c or -S");
+    }
+
+    if(!params.run && params.runArgs.size())
+    {
+        emit_message(msg::ERROR, "arguments after '--' are only used with --run");
+    }
+
     return params;
 }
 
@@ -230,10 +454,27 @@ void deinit(WLConfig &config)
 
 int main(int argc, char **argv)
 {
+    for(int i = 1; i < argc; i++)
+    {
+        if(!strcmp(argv[i], "--connect") || !strncmp(argv[i], "--connect=", 10))
+        {
+            std::string socketPath = argv[i][9] ? std::string(argv[i] + 10) : defaultSocketPath();
+            int status = runClient(socketPath, argc, argv);
+            if(status >= 0) return status;
+            emit_message(msg::WARNING, "unable to reach compile server at '" + socketPath + "', compiling locally");
+            resetErrorLevel();
+        }
+    }
+
     WLConfig param = parseCmd(argc, argv);
     if(currentErrorLevel()) return -1; // failure to parse args
-    compile(param);
+    if(param.serve)
+    {
+        deinit(param);
+        return runServer(param);
+    }
+    int status = compile(param);
     deinit(param);
     if(currentErrorLevel() > msg::WARNING) return currentErrorLevel(); // failure to compile
-    return 0;
+    return status;
 }
@@ -0,0 +1,14 @@
+#ifndef _MAIN_HPP
+#define _MAIN_HPP
+
+#include "config.hpp"
+#include "parser.hpp"
+
+// compiler driver, defined in main.cpp
+
+WLConfig parseCmd(int argc, char **argv);
+void parseSources(Parser *parser, WLConfig &params);
+int compileAST(AST *ast, WLConfig &params); // exit status of the program with --run
+void deinit(WLConfig &config);
+
+#endif
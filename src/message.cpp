@@ -4,16 +4,30 @@
 #include <stdio.h>
 #include <stdlib.h>
 
+#include <llvm/Support/Mutex.h>
+
 using namespace std;
 using namespace msg;
 
 static int errLvl = 0;
 
+// messages may come from several parsing threads; keep each one whole
+static llvm::sys::Mutex &getLock()
+{
+    static llvm::sys::Mutex lock;
+    return lock;
+}
+
 int currentErrorLevel()
 {
     return errLvl;
 }
 
+void resetErrorLevel()
+{
+    errLvl = 0;
+}
+
 void cond_message(int cond, int level, std::string msg, SourceLocation loc)
 {
     if(cond) emit_message(level, msg, loc);
@@ -26,6 +40,7 @@ void assert_message(int assert, int lvl, std::string msg, SourceLocation loc)
 
 void emit_message(int level, std::string msg, SourceLocation loc)
 {
+    llvm::sys::ScopedLock guard(getLock());
     if(level > errLvl) errLvl = level;
 
     if(loc.filenm)
@@ -0,0 +1,154 @@
+#include "moduleCache.hpp"
+#include "irDebug.hpp"
+#include "irTarget.hpp"
+#include "message.hpp"
+#include "file.hpp"
+
+#include <sys/stat.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <fstream>
+#include <sstream>
+#include <algorithm>
+
+#ifdef WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#endif
+
+static uint64_t hashString(uint64_t h, std::string str) {
+    // include the terminator so concatenated strings hash differently
+    return hashBytes(h, str.c_str(), str.length() + 1);
+}
+
+static uint64_t hashInt(uint64_t h, uint64_t i) {
+    return hashBytes(h, (const char*) &i, sizeof(i));
+}
+
+static uint64_t hashFile(uint64_t h, std::string filenm) {
+    std::ifstream stream(findFile(filenm).c_str(), std::ios::in | std::ios::binary);
+    if(!stream) return h;
+
+    char buf[4096];
+    while(stream) {
+        stream.read(buf, sizeof(buf));
+        h = hashBytes(h, buf, stream.gcount());
+    }
+    return h;
+}
+
+ModuleCache::ModuleCache(std::string directory, AST *a, WLConfig &config) :
+    dir(directory), ast(a) {
+    if(!dir.empty() && dir[dir.length()-1] == '/') dir.erase(dir.length()-1);
+
+    if(!makeDirectory(dir)) {
+        emit_message(msg::WARNING, "unable to create cache directory '" + dir + "'");
+    }
+
+    configHash = hashString(HASH_SEED, CGSTR);
+    configHash = hashInt(configHash, LLVM_VERSION_MAJOR * 100 + LLVM_VERSION_MINOR);
+    configHash = hashInt(configHash, config.debug);
+    configHash = hashInt(configHash, config.reorderFields); // changes class layouts
+}
+
+std::string ModuleCache::defaultDirectory() {
+    if(const char *env = getenv("WLCACHE")) {
+        return env;
+    }
+
+    if(const char *home = getenv("HOME")) {
+        return std::string(home) + "/.cache/wlc";
+    }
+
+    return "";
+}
+
+uint64_t ModuleCache::getSourceHash(ModuleDeclaration *m) {
+    if(sourceHashes.count(m)) return sourceHashes[m];
+
+    uint64_t h = hashString(HASH_SEED, m->filenm);
+    if(m->filenm == "__C") {
+        // C imports all share one module; hash every header that went into it
+        std::map<std::string, ModuleDeclaration*>::iterator it;
+        for(it = ast->modules.begin(); it != ast->modules.end(); it++) {
+            if(it->second == m) {
+                h = hashString(h, it->first);
+                h = hashFile(h, it->first);
+            }
+        }
+    } else {
+        h = hashFile(h, m->filenm);
+    }
+
+    sourceHashes[m] = h;
+    return h;
+}
+
+void ModuleCache::collectImports(ModuleDeclaration *m, std::set<ModuleDeclaration*> &visited,
+        std::vector<ModuleDeclaration*> &list) {
+    if(!m || visited.count(m)) return;
+    visited.insert(m);
+    list.push_back(m);
+
+    ASTScope::iterator it;
+    for(it = m->importScope->begin(); it != m->importScope->end(); it++) {
+        Identifier *mod_id = *it;
+        if(mod_id->getDeclaration()) {
+            collectImports(mod_id->getDeclaration()->moduleDeclaration(), visited, list);
+        }
+    }
+}
+
+uint64_t ModuleCache::getKey(ModuleDeclaration *m) {
+    std::set<ModuleDeclaration*> visited;
+    std::vector<ModuleDeclaration*> imports;
+    collectImports(ast->getRuntimeModule(), visited, imports);
+    collectImports(m, visited, imports);
+
+    // order independent of import order (and import cycles)
+    std::vector<uint64_t> hashes;
+    for(int i = 0; i < imports.size(); i++) {
+        hashes.push_back(getSourceHash(imports[i]));
+    }
+    std::sort(hashes.begin(), hashes.end());
+
+    uint64_t h = hashInt(configHash, getSourceHash(m));
+    h = hashString(h, m->getName());
+    for(int i = 0; i < hashes.size(); i++) {
+        h = hashInt(h, hashes[i]);
+    }
+
+    return h;
+}
+
+std::string ModuleCache::getPath(ModuleDeclaration *m) {
+    char key[17];
+    sprintf(key, "%016llx", (unsigned long long) getKey(m));
+    return dir + "/" + key + ".bc";
+}
+
+llvm::Module *ModuleCache::load(ModuleDeclaration *m, llvm::LLVMContext &context) {
+    std::string path = getPath(m);
+    if(!fileExists(path)) return NULL;
+
+    return readIRFile(path, context);
+}
+
+void ModuleCache::discard(ModuleDeclaration *m) {
+    remove(getPath(m).c_str());
+}
+
+void ModuleCache::store(ModuleDeclaration *m, llvm::Module *llvmModule) {
+    std::string path = getPath(m);
+
+    // write to a private name first, so concurrent compiles never see a
+    // partially written file
+    std::stringstream tmp;
+    tmp << path << "." << getpid() << ".tmp";
+    if(writeBitcodeFile(llvmModule, tmp.str())) {
+        rename(tmp.str().c_str(), path.c_str());
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef _MODULECACHE_HPP
+#define _MODULECACHE_HPP
+
+#include <llvm/IR/Module.h>
+#include <llvm/IR/LLVMContext.h>
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <set>
+#include <map>
+
+#include "ast.hpp"
+#include "config.hpp"
+
+/*
+ * on-disk cache of per-module bitcode.
+ *
+ * a module's key is a hash of its own source, the source of every module
+ * it can (transitively) see through imports, the runtime module and the
+ * configuration options that change generated code. if nothing that
+ * could affect a module's codegen has changed, its bitcode is reused.
+ */
+class ModuleCache
+{
+    std::string dir;
+    AST *ast;
+    uint64_t configHash;
+    std::map<ModuleDeclaration*, uint64_t> sourceHashes;
+
+    uint64_t getSourceHash(ModuleDeclaration *m);
+    void collectImports(ModuleDeclaration *m, std::set<ModuleDeclaration*> &visited,
+            std::vector<ModuleDeclaration*> &list);
+
+    public:
+    ModuleCache(std::string directory, AST *a, WLConfig &config);
+
+    // $WLCACHE, or ~/.cache/wlc
+    static std::string defaultDirectory();
+
+    uint64_t getKey(ModuleDeclaration *m);
+    std::string getPath(ModuleDeclaration *m);
+
+    // returns cached bitcode for 'm', or NULL if there is none
+    llvm::Module *load(ModuleDeclaration *m, llvm::LLVMContext &context);
+    void store(ModuleDeclaration *m, llvm::Module *llvmModule);
+    void discard(ModuleDeclaration *m); // removes an entry that can't be read
+};
+
+#endif
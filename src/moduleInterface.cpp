@@ -0,0 +1,239 @@
+#include "moduleInterface.hpp"
+#include "file.hpp"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+
+#include <fstream>
+#include <sstream>
+#include <map>
+
+#ifdef WIN32
+#include <process.h>
+#define getpid _getpid
+#else
+#include <unistd.h>
+#include <limits.h>
+#endif
+
+/*
+ * layout (native byte order):
+ *  "WLI\0", format hash, source content hash, source path
+ *  string count, then each string
+ *  token count, then each token: kind, newline, length, line, column and,
+ *  for identifiers and strings, a string index; for numbers, 8 bytes of data
+ */
+
+#define WLI_VERSION 2
+
+// token kinds are stored by number; any change to the kinds makes old interfaces stale
+static uint64_t formatHash() {
+    static const char *kindNames[] = {
+#define TOK(X) #X,
+#include "tokenkinds.def"
+    };
+
+    uint64_t h = hashBytes(HASH_SEED, "WLI", 3);
+    int version = WLI_VERSION;
+    h = hashBytes(h, (const char*) &version, sizeof(version));
+    for(int i = 0; i < tok::NUM_TOKENS; i++) {
+        h = hashBytes(h, kindNames[i], strlen(kindNames[i]) + 1);
+    }
+    return h;
+}
+
+static std::string absolutePath(std::string path) {
+#ifdef WIN32
+    char buf[_MAX_PATH];
+    if(_fullpath(buf, path.c_str(), sizeof(buf))) return buf;
+#else
+    char buf[PATH_MAX];
+    if(realpath(path.c_str(), buf)) return buf;
+#endif
+    return path;
+}
+
+static bool hasString(tok::TokenKind kind) {
+    return kind == tok::identifier || kind == tok::charstring;
+}
+
+static bool hasNumber(tok::TokenKind kind) {
+    return kind == tok::intNum || kind == tok::floatNum;
+}
+
+std::string interfacePath(std::string dir, std::string filenm) {
+    std::string path = absolutePath(findFile(filenm));
+
+    char key[17];
+    sprintf(key, "%016llx", (unsigned long long) hashBytes(HASH_SEED,
+                path.c_str(), path.length()));
+    return dir + "/" + key + ".wli";
+}
+
+class InterfaceWriter
+{
+    std::string data;
+
+    public:
+    template<typename T>
+    void put(T value) { data.append((const char*) &value, sizeof(T)); }
+
+    void putString(const std::string &str) {
+        put<uint32_t>(str.length());
+        data.append(str);
+    }
+
+    std::string &getData() { return data; }
+};
+
+class InterfaceReader
+{
+    const std::string &data;
+    size_t pos;
+    bool failed;
+
+    public:
+    InterfaceReader(const std::string &d) : data(d), pos(0), failed(false) {}
+
+    template<typename T>
+    T get() {
+        T value = T();
+        if(failed || data.length() - pos < sizeof(T)) {
+            failed = true;
+            return value;
+        }
+        memcpy(&value, data.data() + pos, sizeof(T));
+        pos += sizeof(T);
+        return value;
+    }
+
+    std::string getString() {
+        uint32_t len = get<uint32_t>();
+        if(failed || data.length() - pos < len) {
+            failed = true;
+            return "";
+        }
+        pos += len;
+        return data.substr(pos - len, len);
+    }
+
+    bool ok() { return !failed; }
+    bool atEnd() { return pos == data.length(); }
+};
+
+bool loadInterface(std::string dir, std::string filenm, std::vector<Token> &tokens,
+        uint64_t &sourceHash) {
+    std::string source = findFile(filenm);
+    if(!hashSourceFile(source, sourceHash)) return false;
+
+    std::ifstream stream(interfacePath(dir, filenm).c_str(), std::ios::in | std::ios::binary);
+    if(!stream) return false;
+    std::stringstream buf;
+    buf << stream.rdbuf();
+    std::string data = buf.str();
+
+    InterfaceReader in(data);
+    char magic[4];
+    for(int i = 0; i < 4; i++) magic[i] = in.get<char>();
+    if(memcmp(magic, "WLI", 4) || in.get<uint64_t>() != formatHash()) return false;
+    if(in.get<uint64_t>() != sourceHash) return false;
+    if(in.getString() != absolutePath(source)) return false; // hash collision
+
+    std::vector<InternedString> strings(in.get<uint32_t>());
+    for(size_t i = 0; i < strings.size() && in.ok(); i++) {
+        strings[i] = intern(in.getString());
+    }
+
+    const char *locfile = intern(filenm)->c_str(); // as the lexer would name it
+    uint32_t ntokens = in.get<uint32_t>();
+    if(!in.ok()) return false;
+
+    std::vector<Token> toks;
+    toks.reserve(ntokens);
+    for(uint32_t i = 0; i < ntokens && in.ok(); i++) {
+        Token t;
+        uint16_t kind = in.get<uint16_t>();
+        if(kind >= tok::NUM_TOKENS) return false;
+        t.kind = (tok::TokenKind) kind;
+        t.newline = in.get<uint8_t>();
+        t.characters = in.get<uint16_t>();
+        t.loc.filenm = locfile;
+        t.loc.line = in.get<int32_t>();
+        t.loc.ch = in.get<int32_t>();
+
+        if(hasString(t.kind)) {
+            uint32_t index = in.get<uint32_t>();
+            if(index >= strings.size()) return false;
+            t.strData = strings[index];
+        } else if(hasNumber(t.kind)) {
+            t.iData = in.get<int64_t>();
+        }
+        toks.push_back(t);
+    }
+
+    if(!in.ok() || !in.atEnd()) return false;
+    tokens.swap(toks);
+    return true;
+}
+
+void storeInterface(std::string dir, std::string filenm, const std::vector<Token> &tokens,
+        uint64_t sourceHash) {
+    // hashed as it was lexed; the source may have changed since
+    std::string source = findFile(filenm);
+    if(!makeDirectory(dir)) return;
+
+    std::map<InternedString, uint32_t> stringIndex;
+    std::vector<InternedString> strings;
+    for(size_t i = 0; i < tokens.size(); i++) {
+        // the length of a longer token was not kept; leave it to the lexer
+        if(tokens[i].characters == USHRT_MAX) return;
+
+        if(hasString(tokens[i].kind) && !stringIndex.count(tokens[i].strData)) {
+            stringIndex[tokens[i].strData] = strings.size();
+            strings.push_back(tokens[i].strData);
+        }
+    }
+
+    InterfaceWriter out;
+    out.put<char>('W'); out.put<char>('L'); out.put<char>('I'); out.put<char>('\0');
+    out.put<uint64_t>(formatHash());
+    out.put<uint64_t>(sourceHash);
+    out.putString(absolutePath(source));
+
+    out.put<uint32_t>(strings.size());
+    for(size_t i = 0; i < strings.size(); i++) {
+        out.putString(*strings[i]);
+    }
+
+    out.put<uint32_t>(tokens.size());
+    for(size_t i = 0; i < tokens.size(); i++) {
+        const Token &t = tokens[i];
+        out.put<uint16_t>(t.kind);
+        out.put<uint8_t>(t.newline);
+        out.put<uint16_t>(t.characters);
+        out.put<int32_t>(t.loc.line);
+        out.put<int32_t>(t.loc.ch);
+
+        if(hasString(t.kind)) {
+            out.put<uint32_t>(stringIndex[t.strData]);
+        } else if(hasNumber(t.kind)) {
+            out.put<int64_t>(t.iData);
+        }
+    }
+
+    // write to a private name first, so concurrent compiles never see a
+    // partially written file
+    std::string path = interfacePath(dir, filenm);
+    std::stringstream tmp;
+    tmp << path << "." << getpid() << ".tmp";
+    std::ofstream file(tmp.str().c_str(), std::ios::out | std::ios::binary);
+    file.write(out.getData().data(), out.getData().length());
+    file.close();
+    if(file) {
+        rename(tmp.str().c_str(), path.c_str());
+    } else {
+        remove(tmp.str().c_str());
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef _MODULEINTERFACE_HPP
+#define _MODULEINTERFACE_HPP
+
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#include "token.hpp"
+
+/*
+ * module interface files (.wli), kept next to the cached bitcode in the
+ * module cache directory.
+ *
+ * an interface holds a module's source already lexed: every token but
+ * comments, with the strings they refer to stored once. a module with an
+ * up to date interface is parsed from its tokens instead of its source.
+ * an interface is up to date while the source keeps the content it had
+ * when the interface was written.
+ */
+
+// where the interface of source file 'filenm' is kept in 'dir'
+std::string interfacePath(std::string dir, std::string filenm);
+
+// fills 'tokens' from the interface of 'filenm', and 'sourceHash' with the
+// hash (hashSourceFile) of the source they were lexed from. returns false
+// if there is no up to date interface
+bool loadInterface(std::string dir, std::string filenm, std::vector<Token> &tokens,
+        uint64_t &sourceHash);
+
+// 'sourceHash' is the hash of the content 'tokens' were lexed from
+void storeInterface(std::string dir, std::string filenm, const std::vector<Token> &tokens,
+        uint64_t sourceHash);
+
+#endif
@@ -0,0 +1,97 @@
+#include "parseQueue.hpp"
+
+#ifndef WIN32
+
+#include "parser.hpp"
+#include "message.hpp"
+
+#include <vector>
+
+// the parser recurses deeply on nested expressions; don't rely on the
+// platform's default thread stack (512KB on OSX)
+#define PARSE_THREAD_STACK (8 * 1024 * 1024)
+
+ParseQueue::ParseQueue(Parser *p) : parser(p), active(0)
+{
+    pthread_mutex_init(&mutex, NULL);
+    pthread_cond_init(&cond, NULL);
+}
+
+ParseQueue::~ParseQueue()
+{
+    pthread_cond_destroy(&cond);
+    pthread_mutex_destroy(&mutex);
+}
+
+void ParseQueue::push(ModuleDeclaration *module, File *file, SourceLocation loc)
+{
+    Job job;
+    job.module = module;
+    job.file = file;
+    job.loc = loc;
+
+    pthread_mutex_lock(&mutex);
+    jobs.push_back(job);
+    pthread_cond_signal(&cond);
+    pthread_mutex_unlock(&mutex);
+}
+
+void *ParseQueue::worker(void *q)
+{
+    ParseQueue *queue = (ParseQueue*) q;
+    ArenaScope arena(queue->parser->getAST()->newArena());
+    queue->work();
+    return NULL;
+}
+
+void ParseQueue::work()
+{
+    pthread_mutex_lock(&mutex);
+    while(true)
+    {
+        while(jobs.empty() && active) pthread_cond_wait(&cond, &mutex);
+        if(jobs.empty()) break; // nothing queued, and nothing left to queue more
+
+        Job job = jobs.front();
+        jobs.pop_front();
+        active++;
+        pthread_mutex_unlock(&mutex);
+
+        parser->parseModuleFile(job.module, job.file, job.loc);
+
+        pthread_mutex_lock(&mutex);
+        active--;
+        if(jobs.empty() && !active) pthread_cond_broadcast(&cond); // done
+    }
+    pthread_mutex_unlock(&mutex);
+}
+
+void ParseQueue::run(int threads)
+{
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+    pthread_attr_setstacksize(&attr, PARSE_THREAD_STACK);
+
+    std::vector<pthread_t> workers;
+    for(int i = 1; i < threads; i++)
+    {
+        pthread_t thread;
+        if(pthread_create(&thread, &attr, worker, this))
+        {
+            // carry on with the threads we have
+            emit_message(msg::WARNING, "unable to start parsing thread");
+            break;
+        }
+        workers.push_back(thread);
+    }
+    pthread_attr_destroy(&attr);
+
+    work();
+
+    for(int i = 0; i < workers.size(); i++)
+    {
+        pthread_join(workers[i], NULL);
+    }
+}
+
+#endif
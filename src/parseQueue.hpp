@@ -0,0 +1,55 @@
+#ifndef _PARSEQUEUE_HPP
+#define _PARSEQUEUE_HPP
+
+#ifndef WIN32
+
+#include <pthread.h>
+
+#include <deque>
+
+#include "ast.hpp"
+#include "file.hpp"
+#include "sourceLocation.hpp"
+
+class Parser;
+
+/*
+ * files waiting to be parsed, for parsing imports on several threads.
+ *
+ * while a queue is running, each import found is pushed here instead of
+ * being parsed on the spot. the threads running the queue (the caller of
+ * run() and its workers) take files until the queue is empty and no file
+ * is still being parsed, since a file being parsed may import more.
+ * every worker parses into its own arena, owned by the AST.
+ */
+class ParseQueue
+{
+    struct Job
+    {
+        ModuleDeclaration *module;
+        File *file;
+        SourceLocation loc;
+    };
+
+    Parser *parser;
+    std::deque<Job> jobs;
+    int active; // files being parsed
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+
+    static void *worker(void *queue);
+    void work();
+
+    public:
+    ParseQueue(Parser *p);
+    ~ParseQueue();
+
+    void push(ModuleDeclaration *module, File *file, SourceLocation loc);
+
+    // parses on this thread and 'threads - 1' more until every file is parsed
+    void run(int threads);
+};
+
+#endif
+
+#endif
@@ -12,10 +12,15 @@
 #include <iostream>
 
 #include "parser.hpp"
+#include "parseQueue.hpp"
 #include "streamLexer.hpp"
+#include "bufferLexer.hpp"
+#include "tokenLexer.hpp"
+#include "moduleInterface.hpp"
 #include "ast.hpp"
 #include "message.hpp"
 #include "parsec.hpp"
+#include "timing.hpp"
 
 
 using namespace llvm;
@@ -24,32 +29,20 @@ using namespace std;
 // prepare for recovery if failed parsing
 void ParseContext::pushRecover()
 {
-    recoveryState.push_back(rqueue.size());
+    marks.push_back(cursor);
 }
 
 // drop recovery info once not needed
 void ParseContext::popRecover()
 {
-    recoveryState.pop_back();
-    if(!recoveryState.size())
-    {
-        while(rqueue.size())
-        {
-            rqueue.pop_front();
-        }
-    }
+    marks.pop_back();
 }
 
 // recover from failed parsing
 void ParseContext::recover()
 {
-    int endpop = recoveryState.back();
-    recoveryState.pop_back();
-    while(rqueue.size() > endpop)
-    {
-        tqueue.push_front(rqueue.back());
-        rqueue.pop_back();
-    }
+    cursor = marks.back();
+    marks.pop_back();
 }
 
 ASTType *ParseContext::parseBasicType() {
@@ -145,7 +138,7 @@ ASTType *ParseContext::parseScalarType() {
     if(t.is(tok::identifier)) {
         ignore();
         //TODO: should be get so structs dont need fwd decl?
-        Identifier *id = getScope()->get(t.toString());
+        Identifier *id = getScope()->get(t.internedString());
         if(!id) {
             emit_message(msg::ERROR, "unknown type or variable", t.loc);
             return NULL;
@@ -393,33 +386,51 @@ ImportExpression *ParseContext::parseImport()
     if(StringExpression *sexp = dynamic_cast<StringExpression*>(importExpression)) {
         std::string filenm = sexp->string;
         std::string modnm = getFilebase(filenm);
-        importedModule = ast->getModule(filenm);
-        if(!importedModule) { // This TU hasnt been loaded from file yet, DOIT
-            Identifier *m_id = getModule()->importScope->get(modnm);
-
-            if(special) {
-                if(getScope()->extensionEnabled("importc") && parserType == "C") {
-                    static ModuleDeclaration *CModule = NULL;
-                    if(!CModule) {
-                        Identifier *c_id = getModule()->importScope->get("__C");
-                        CModule = new ModuleDeclaration(ast->getRootPackage(), c_id, "__C");
-                        c_id->addDeclaration(CModule, Identifier::ID_MODULE);
+        Identifier *m_id = getModule()->importScope->get(modnm);
+        bool parse = false;
+
+        {
+            // other threads may be importing the same module
+            llvm::sys::ScopedLock guard(ast->getLock());
+            importedModule = ast->getModule(filenm);
+            if(!importedModule) { // This TU hasnt been loaded from file yet, DOIT
+                if(special) {
+                    if(getScope()->extensionEnabled("importc") && parserType == "C") {
+                        ModuleDeclaration *CModule = ast->getCModule();
+                        if(!CModule) {
+                            Identifier *c_id = getModule()->importScope->get("__C");
+                            CModule = new ModuleDeclaration(ast->getRootPackage(), c_id, "__C");
+                            c_id->addDeclaration(CModule, Identifier::ID_MODULE);
+                            ast->setCModule(CModule);
+                        }
+                        importedModule = CModule;
+                        ast->addModule(sexp->string, importedModule);
+                        TimeScope scope("importc", sexp->string);
+                        uint64_t h; // hashed before clang reads it
+                        std::string path = findFile(sexp->string);
+                        if(ast->hashSources && hashSourceFile(path, h)) ast->addSourceHash(path, h);
+                        parseCImport(importedModule, sexp->string, loc); // the C module is shared; keep the lock
+                    } else {
+                        emit_message(msg::ERROR, "unknown import type '" + parserType + "'", loc);
                     }
-                    importedModule = CModule;
-                    m_id->addDeclaration(importedModule, Identifier::ID_MODULE);
-                    ast->addModule(sexp->string, importedModule);
-                    parseCImport(importedModule, sexp->string, loc);
                 } else {
-                    emit_message(msg::ERROR, "unknown import type '" + parserType + "'", loc);
+                    importedModule = new ModuleDeclaration(ast->getRootPackage(), m_id, sexp->string);
+                    ast->addModule(sexp->string, importedModule);
+                    parse = true;
                 }
-            } else {
-                importedModule = new ModuleDeclaration(ast->getRootPackage(), m_id, sexp->string);
-                m_id->addDeclaration(importedModule, Identifier::ID_MODULE);
-                ast->addModule(sexp->string, importedModule);
-                parser->parseFile(importedModule, new File(sexp->string), loc);
             }
         }
 
+        // every importer names the module in its import scope, not only the
+        // first; which importer is first depends on thread timing
+        if(importedModule && m_id->isUndeclared()) {
+            m_id->addDeclaration(importedModule, Identifier::ID_MODULE);
+        }
+
+        if(parse) {
+            parser->parseImport(importedModule, new File(sexp->string), loc);
+        }
+
         //XXX add a local identifier to refer to module
         //Identifier *local_mid = getScope()->getInScope(modnm);
         //local_mid->addDeclaration(importedModule, Identifier::ID_MODULE);
@@ -427,7 +438,11 @@ ImportExpression *ParseContext::parseImport()
 
     cond_message(!importedModule, msg::FAILURE, "failed to import module");
 
-    getScope()->addSibling(importedModule->getScope());
+    if(parser->parsingInParallel()) {
+        deferredImports.push_back(std::make_pair(getScope(), importedModule));
+    } else {
+        getScope()->addSibling(importedModule->getScope());
+    }
     return new ImportExpression(importExpression, importedModule, loc);
 }
 
@@ -439,7 +454,7 @@ Statement *ParseContext::parseStatement()
     switch(peek().kind)
     {
         case tok::identifier:
-            id = getScope()->lookup(peek().toString());
+            id = getScope()->lookup(peek().internedString());
             if(id && id->isVariable()) goto PARSEEXP;
         case tok::lbracket:
                 pushRecover();
@@ -513,7 +528,7 @@ PARSEEXP:
                 dropLine();
                 return NULL;
             }
-            id = getScope()->get(get().toString());
+            id = getScope()->get(get().internedString());
             id->addDeclaration(NULL, Identifier::ID_LABEL); // set as label; XXX do we need decl?
             return new LabelStatement(id, loc);
 
@@ -526,7 +541,7 @@ PARSEEXP:
                 dropLine();
                 return NULL;
             }
-            return new GotoStatement(getScope()->get(get().toString()), loc);
+            return new GotoStatement(getScope()->get(get().internedString()), loc);
 
         case tok::kw_continue:
             ignore();
@@ -623,8 +638,8 @@ Declaration *ParseContext::parseDeclaration()
             return NULL;
         }
 
-        if(getScope()->contains(t_id.toString()) &&
-                !(getScope()->lookup(t_id.toString()))->isUndeclared()){
+        if(getScope()->contains(t_id.internedString()) &&
+                !(getScope()->lookup(t_id.internedString()))->isUndeclared()){
             emit_message(msg::ERROR,
                 std::string("redeclaration of struct ") +
                 string("'") + t_id.toString() + string("'"), t_id.loc);
@@ -632,7 +647,7 @@ Declaration *ParseContext::parseDeclaration()
             return NULL;
         }
 
-        Identifier *id = getScope()->get(t_id.toString());
+        Identifier *id = getScope()->get(t_id.internedString());
         Identifier *baseId = NULL;
 
         if(peek().is(tok::colon)) {
@@ -641,10 +656,9 @@ Declaration *ParseContext::parseDeclaration()
                 emit_message(msg::ERROR, "only classes can inherit from a base", peek().loc);
             }
 
-            baseId = getScope()->get(get().toString());
+            baseId = getScope()->get(get().internedString());
         } else if(kind == kw_class && id->getName() != "Object") { //TODO: inherits void
-            static Identifier *objectId = NULL;
-            if(!objectId) objectId = getAST()->getRuntimeModule()->lookup("Object");
+            Identifier *objectId = getAST()->getRuntimeModule()->lookup("Object");
             if(!objectId) {
                 emit_message(msg::FAILURE, "runtime package not found; could not find an 'Object' declaration");
             }
@@ -789,7 +803,7 @@ NEXT:
     }
 
     // this identifier has already been defined! if lparen is upcoming, this is a function, give it a free pass to allow for overloading
-    if(getScope()->lookupInScope(t_id.toString()) && peek().isNot(tok::lparen)){
+    if(getScope()->lookupInScope(t_id.internedString()) && peek().isNot(tok::lparen)){
         emit_message(msg::ERROR,
             string("redeclaration of variable ") + string("'") + t_id.toString() + string("'"),
             t_id.loc);
@@ -797,7 +811,7 @@ NEXT:
         return NULL;
     }
 
-    id = getScope()->getInScope(t_id.toString());
+    id = getScope()->getInScope(t_id.internedString());
     if(id->getName() == "main") dqual.decorated = false; // dont mangle main
 
     //TODO parse decl specs
@@ -847,7 +861,7 @@ PARSEFUNC:
 
             ASTType *aty = parseType();
             Token t_name = get();
-            Identifier *paramId = getScope()->getInScope(t_name.toString());
+            Identifier *paramId = getScope()->getInScope(t_name.internedString());
 
             Expression *defaultValue = NULL;
 
@@ -877,13 +891,25 @@ PARSEFUNC:
         }
         ignore(); //rparen
 
-        // body
-        Statement *stmt = parseStatement();
+        // body. bodies of imported modules may be skipped (-flazy-parse); not
+        // while speculating, the declaration might be thrown away
+        Statement *stmt = NULL;
+        LazyBody *lazy = NULL;
+        if(parser->lazyBodies() && !getModule()->expl && marks.empty() &&
+                peek().is(tok::lbrace)) {
+            lazy = skipFunctionBody();
+        } else {
+            stmt = parseStatement();
+        }
         popScope();
 
         ASTType *ownty = owner ? owner->getDeclaredType() : NULL;
-        Declaration *decl = new FunctionDeclaration(id, ownty, type, parameters, vararg,
+        FunctionDeclaration *decl = new FunctionDeclaration(id, ownty, type, parameters, vararg,
                 funcScope, stmt, idLoc, dqual);
+        if(lazy) {
+            decl->lazyBody = lazy;
+            getModule()->lazyFunctions.push_back(decl);
+        }
         id->addDeclaration(decl, Identifier::ID_FUNCTION);
         return decl;
     }
@@ -1333,7 +1359,7 @@ Expression *ParseContext::parseIdentifierExpression()
         return NULL;
     }
 
-    Identifier *id = getScope()->get(get().toString());
+    Identifier *id = getScope()->get(get().internedString());
     IdentifierExpression *ret = new IdentifierExpression(id, loc);
     return ret;
 }
@@ -1482,7 +1508,9 @@ Expression *ParseContext::parseBinaryExpression(int prec)
 void ParseContext::parseModule(ModuleDeclaration *module)
 {
     this->module = module;
-    currentPackage()->addPackage(module);
+    if(!parser->parsingInParallel()) {
+        currentPackage()->addPackage(module);
+    }
 
     pushScope(module->getScope());
     while(peek().isNot(tok::eof))
@@ -1491,9 +1519,130 @@ void ParseContext::parseModule(ModuleDeclaration *module)
     }
     popScope();
     assert_message(!getScope(), msg::FAILURE, "invalid scope stack!", peek().loc);
+
+    if(parser->parsingInParallel()) {
+        std::vector<ModuleDeclaration*> imports;
+        for(int i = 0; i < deferredImports.size(); i++) {
+            deferredImports[i].first->addSibling(deferredImports[i].second->getScope());
+            imports.push_back(deferredImports[i].second);
+        }
+        parser->moduleParsed(module, imports);
+    }
+}
+
+// records the tokens of a function body, up to its matching '}'
+LazyBody *ParseContext::skipFunctionBody()
+{
+    LazyBody *lazy = new LazyBody;
+    lazy->parser = parser;
+    lazy->module = getModule();
+
+    int depth = 0;
+    do {
+        Token t = get();
+        if(t.is(tok::eof)) {
+            emit_message(msg::ERROR, "expected '}' to end function body", t.loc);
+            break;
+        }
+
+        if(t.is(tok::lbrace)) depth++;
+        else if(t.is(tok::rbrace)) depth--;
+        lazy->tokens.push_back(t);
+    } while(depth > 0);
+
+    return lazy;
+}
+
+void ParseContext::parseLazyBody(FunctionDeclaration *fdecl)
+{
+    module = fdecl->lazyBody->module;
+    pushScope(fdecl->getScope());
+    fdecl->body = parseStatement();
+    popScope();
+}
+
+void parseLazyBodies(ModuleDeclaration *module)
+{
+    if(module->lazyFunctions.empty()) return;
+
+    TimeScope scope("parse bodies", module->filenm);
+
+    // a body may hold nested functions, which are skipped again
+    while(!module->lazyFunctions.empty()) {
+        std::vector<FunctionDeclaration*> functions;
+        functions.swap(module->lazyFunctions);
+
+        for(int i = 0; i < functions.size(); i++) {
+            FunctionDeclaration *fdecl = functions[i];
+            LazyBody *lazy = fdecl->lazyBody;
+
+            TokenLexer lexer(lazy->tokens);
+            Parser *parser = lazy->parser;
+            ParseContext context(&lexer, parser, parser->getAST()->getRootPackage());
+            context.parseLazyBody(fdecl);
+
+            fdecl->lazyBody = NULL;
+            std::vector<Token>().swap(lazy->tokens); // the rest is freed with the arena
+        }
+    }
 }
 
 void Parser::parseFile(ModuleDeclaration *module, File *file, SourceLocation l)
+{
+    ArenaScope arena(ast->getArena());
+
+#ifndef WIN32
+    if(jobs > 1 && !queue) {
+        ParseQueue q(this);
+        queue = &q;
+        q.push(module, file, l);
+        q.run(jobs);
+        queue = NULL;
+
+        // add modules to the package in the order a serial parse would have
+        std::set<ModuleDeclaration*> visited;
+        addParsedModule(module, visited);
+        parsedImports.clear();
+        return;
+    }
+#endif
+
+    parseModuleFile(module, file, l);
+}
+
+void Parser::parseImport(ModuleDeclaration *module, File *file, SourceLocation l)
+{
+#ifndef WIN32
+    if(queue) {
+        queue->push(module, file, l);
+        return;
+    }
+#endif
+
+    parseModuleFile(module, file, l);
+}
+
+void Parser::moduleParsed(ModuleDeclaration *module, std::vector<ModuleDeclaration*> &imports)
+{
+    llvm::sys::ScopedLock guard(ast->getLock());
+    parsedImports[module] = imports;
+}
+
+// depth first, in import order, skipping modules parsed before this file
+void Parser::addParsedModule(ModuleDeclaration *module, std::set<ModuleDeclaration*> &visited)
+{
+    if(visited.count(module) || !parsedImports.count(module)) return;
+    visited.insert(module);
+
+    ast->getRootPackage()->addPackage(module);
+    std::vector<ModuleDeclaration*> &imports = parsedImports[module];
+    for(int i = 0; i < imports.size(); i++) {
+        addParsedModule(imports[i], visited);
+    }
+}
+
+// parses on the calling thread, into its current arena
+void Parser::parseModuleFile(ModuleDeclaration *module, File *file, SourceLocation l)
 {
     // if we can't open the specified file, check if the file is in the 'lib' dir
     // if we still can't find it; throw a fit
@@ -1503,9 +1652,55 @@ void Parser::parseFile(ModuleDeclaration *module, File *file, SourceLocation l)
         return;
     }
 
-    Lexer *lexer = new StreamLexer(file->getStream());
+    TimeScope scope("parse", file->getName());
+    if(!interfaceDir.empty() && parseModuleInterface(module, file))
+    {
+        return;
+    }
+
+    BufferLexer *lexer = new BufferLexer(findFile(file->getName()));
     lexer->setFilename(file->getName());
+    if(ast->hashSources) ast->addSourceHash(findFile(file->getName()), lexer->contentHash());
     ParseContext context(lexer, this, ast->getRootPackage());
     context.parseModule(module);
     delete lexer;
 }
+
+// parses 'module' from its interface file, writing the interface first if
+// it is missing or stale. returns false if the source has to be parsed
+// directly instead (a character the lexer does not know)
+bool Parser::parseModuleInterface(ModuleDeclaration *module, File *file)
+{
+    std::vector<Token> tokens;
+    uint64_t sourceHash;
+    bool loaded = loadInterface(interfaceDir, file->getName(), tokens, sourceHash);
+    bool valid = true;
+    if(!loaded)
+    {
+        BufferLexer lexer(findFile(file->getName()));
+        lexer.setFilename(file->getName());
+        sourceHash = lexer.contentHash();
+        while(!lexer.eof())
+        {
+            if(lexer.peek().is(tok::none)) return false;
+
+            Token t = lexer.get();
+            if(t.isNot(tok::comment)) tokens.push_back(t);
+        }
+
+        // lexing errors would not be reported again from the interface
+        valid = currentErrorLevel() < msg::ERROR;
+    }
+
+    TokenLexer lexer(tokens);
+    ParseContext context(&lexer, this, ast->getRootPackage());
+    context.parseModule(module);
+
+    if(!loaded && valid)
+    {
+        storeInterface(interfaceDir, file->getName(), tokens, sourceHash);
+    }
+
+    if(ast->hashSources) ast->addSourceHash(findFile(file->getName()), sourceHash);
+    return true;
+}
@@ -11,19 +11,65 @@
 #include "sourceLocation.hpp"
 #include "file.hpp"
 
-#include <deque>
 #include <vector>
 #include <map>
+#include <set>
 #include <stack>
 
+class ParseQueue;
+class Parser;
+
+// a function body skipped by -flazy-parse; the tokens from '{' to '}'
+struct LazyBody
+{
+    ARENA_ALLOCATED(LazyBody)
+
+    Parser *parser;
+    ModuleDeclaration *module;
+    std::vector<Token> tokens;
+};
+
+// parses the skipped function bodies of 'mod'
+void parseLazyBodies(ModuleDeclaration *mod);
+
 // wait, this doesn't really do anything anymore. all the parsing in ParseContext
 class Parser
 {
     AST *ast;
+    int jobs;
+    bool lazy;
+    std::string interfaceDir; // empty unless module interfaces are used
+    ParseQueue *queue; // set while imports are parsed on several threads
+
+    // modules parsed by the queue, and the modules each imports (in order)
+    std::map<ModuleDeclaration*, std::vector<ModuleDeclaration*> > parsedImports;
+
+    void parseModuleFile(ModuleDeclaration *mod, File *file, SourceLocation l);
+    bool parseModuleInterface(ModuleDeclaration *mod, File *file);
+    void addParsedModule(ModuleDeclaration *mod, std::set<ModuleDeclaration*> &visited);
+    friend class ParseQueue;
 
     public:
-        Parser() { ast = new AST(); }
+        Parser() : jobs(1), lazy(false), queue(NULL) { ast = new AST(); }
+
+        // parse imported files on up to 'n' threads
+        void setJobs(int n) { jobs = n; }
+
+        // skip function bodies of imported modules until they are needed
+        void setLazyBodies(bool l) { lazy = l; }
+        bool lazyBodies() { return lazy; }
+
+        // parse modules from interface files (.wli) kept in 'dir'
+        void setInterfaceDir(std::string dir) { interfaceDir = dir; }
+        bool parsingInParallel() { return queue != NULL; }
+
+        // parses 'file' into 'mod'. returns once every file it imports is parsed too
         void parseFile(ModuleDeclaration *mod, File *file, SourceLocation l = SourceLocation());
+
+        // parses a module imported by a file being parsed. in parallel, it is queued
+        void parseImport(ModuleDeclaration *mod, File *file, SourceLocation l);
+        void moduleParsed(ModuleDeclaration *mod, std::vector<ModuleDeclaration*> &imports);
+
         void parseString(const char *str);
         AST *getAST() { return ast; }
 
@@ -49,42 +95,50 @@ class ParseContext
     std::stack<ASTScope*> scope;
     //std::stack<Lexer*> lexers;
 
+    // when parsing in parallel, imported modules may still be in the middle
+    // of their own parse. their scopes are only made visible once this
+    // module is parsed; until then, names from them resolve during sema
+    std::vector<std::pair<ASTScope*, ModuleDeclaration*> > deferredImports;
+
     public:
     ParseContext(Lexer *lex, Parser *parse, PackageDeclaration *p) : lexer(lex), parser(parse),
-        package(p) {}
+        package(p), cursor(0) {}
     ~ParseContext() { }
 
     AST *getAST() { return parser->getAST(); }
 
     protected:
-    std::deque<int> recoveryState; // tokens left over in rqueue after current recover
-    std::deque<Token> rqueue; // recovery queue
-    std::deque<Token> tqueue; // token lookahead queue
+    // tokens are lexed into 'tokens' as the parser first reaches them, and
+    // 'cursor' is the next one to get. backtracking (pushRecover) only marks
+    // a position; recover() rewinds the cursor to it. while nothing is
+    // marked, consumed tokens are dropped from the front of the buffer
+    std::vector<Token> tokens;
+    size_t cursor;
+    std::vector<size_t> marks;
 
     void ignoreComments() {
         while(lexer->peek().is(tok::comment))
             lexer->ignore();
     }
-    //void push() { tqueue.push(getBuffer()); }
-    Token get() {
-        Token t;
-        if(!tqueue.empty()){
-            t = tqueue.front();
-            tqueue.pop_front();
-        } else {
+
+    const Token &tokenAt(size_t i) {
+        while(tokens.size() <= i) {
             ignoreComments();
-            t = lexer->get();
+            tokens.push_back(lexer->get());
         }
-        if(recoveryState.size()) rqueue.push_back(t);
-        return t;
+        return tokens[i];
     }
 
-    Token linePeek() { Token t = peek(); if(!t.followsNewline()) return t; return Token(tok::semicolon); }
-    Token peek() {
-        if(!tqueue.empty()) return tqueue.front();
-        ignoreComments();
-        return lexer->peek();
+    Token get() {
+        if(cursor >= 256 && marks.empty()) {
+            tokens.erase(tokens.begin(), tokens.begin() + cursor);
+            cursor = 0;
+        }
+        return tokenAt(cursor++);
     }
+
+    Token linePeek() { Token t = peek(); if(!t.followsNewline()) return t; return Token(tok::semicolon); }
+    Token peek() { return tokenAt(cursor); }
     void ignore() { get(); }
 
     void dropLine() { // dumps entire line of input given an error (if line ends in binop, dump that too)
@@ -95,19 +149,9 @@ class ParseContext
         //}
     }
 
-    Token lookAhead(int i = 0) { // lookAhead(0) is equivilent to peek()
-        while(tqueue.size() < i+1) {
-            ignoreComments();
-            tqueue.push_back(lexer->get());
-        }
-        return tqueue.at(i);
-    }
-
-    //Token getBuffer() { ignoreComments(); return lexer->get(); }
-    //Token peekBuffer() { ignoreComments(); return lexer->peek(); }
-    //void ignoreBuffer() { ignoreComments(); lexer->ignore(); }
-    //void unGet(Token tok) { lexer->unGet(tok); }
-    bool eof() { return tqueue.empty() && lexer->eof(); }
+    // lookAhead(0) is equivilent to peek()
+    Token lookAhead(int i = 0) { return tokenAt(cursor + i); }
+    bool eof() { return peek().is(tok::eof); }
 
     PackageDeclaration *currentPackage() { return package; }
     ModuleDeclaration *getModule() { return module; }
@@ -122,6 +166,8 @@ class ParseContext
     public:
     void parseModule(ModuleDeclaration *u);
     void parseTopLevel(ModuleDeclaration *unit);
+    LazyBody *skipFunctionBody();
+    void parseLazyBody(FunctionDeclaration *fdecl);
     void pushRecover();
     void popRecover();
     void recover();
@@ -0,0 +1,545 @@
+#include "server.hpp"
+#include "main.hpp"
+#include "message.hpp"
+#include "file.hpp"
+#include "timing.hpp"
+#include "intern.hpp"
+
+#ifdef WIN32
+
+std::string defaultSocketPath() {
+    return "";
+}
+
+int runServer(WLConfig &config) {
+    emit_message(msg::ERROR, "compile server is not supported on this platform");
+    return -1;
+}
+
+int runClient(std::string socketPath, int argc, char **argv) {
+    return -1;
+}
+
+#else
+
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <signal.h>
+#include <limits.h>
+#include <errno.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <map>
+
+#define MAX_WARM_ASTS 32
+
+// the interner never drops a string, and warming parses in the server
+// itself (compiles run in forked children, their strings die with them).
+// once it holds this much, the server starts over in a fresh process
+#define MAX_INTERNED_BYTES (256 << 20)
+
+/*
+ * protocol:
+ *  client sends the working directory followed by argv, each '\0' terminated,
+ *  then shuts down its side of the socket.
+ *  server sends the compiler's output, followed by a '\0' and a status byte
+ *  (the compile's exit status).
+ */
+
+// a source file as it was when parsed. 'hash' is of the content the
+// parser read, so an edit made while (or after) parsing is never taken
+// for what the AST holds
+struct FileStamp
+{
+    std::string path;
+    struct timespec mtime;
+    off_t size;
+    uint64_t hash;
+};
+
+struct WarmAST
+{
+    Parser *parser;
+    std::vector<FileStamp> files;
+    unsigned long lastUse;
+};
+
+// a compile that has been forked off. if it succeeds, the server parses
+// the same sources itself, so the next identical request starts warm
+struct PendingRequest
+{
+    std::string cwd;
+    std::vector<std::string> args;
+    bool warmSources;
+    bool warmRuntime;
+};
+
+static std::map<std::string, WarmAST> warmASTs;
+static std::map<pid_t, PendingRequest> pending;
+static unsigned long useCounter = 0;
+
+// the socket must sit in a directory only we can write to, otherwise another
+// user could put their own server (or a symlink) at the path first
+static bool isOwnedBy(struct stat &st, mode_t type) {
+    return (st.st_mode & S_IFMT) == type && st.st_uid == getuid();
+}
+
+std::string defaultSocketPath() {
+    const char *runtime = getenv("XDG_RUNTIME_DIR");
+    if(runtime && *runtime) return std::string(runtime) + "/wlc.sock";
+
+    std::stringstream ss;
+    ss << "/tmp/wlc-" << getuid();
+    std::string dir = ss.str();
+
+    struct stat st;
+    if(mkdir(dir.c_str(), 0700) && errno != EEXIST) {
+        emit_message(msg::ERROR, "unable to create '" + dir + "': " + strerror(errno));
+        return "";
+    }
+    if(lstat(dir.c_str(), &st) || !isOwnedBy(st, S_IFDIR) || (st.st_mode & 077)) {
+        emit_message(msg::ERROR, "'" + dir + "' is not a private directory owned by this user");
+        return "";
+    }
+    return dir + "/wlc.sock";
+}
+
+static std::string sourcesKey(std::string cwd, std::vector<std::string> &args) {
+    std::string key = cwd + '\n';
+    for(int i = 1; i < args.size(); i++) {
+        key += args[i] + '\0';
+    }
+    return key;
+}
+
+// every request shares the parsed runtime of its directory
+static std::string runtimeKey(std::string cwd) {
+    return cwd + "\n--runtime";
+}
+
+static struct timespec modifiedTime(struct stat &st) {
+#ifdef __APPLE__
+    return st.st_mtimespec;
+#else
+    return st.st_mtim;
+#endif
+}
+
+static bool stampFile(AST *ast, std::string filenm, FileStamp &stamp) {
+    struct stat st;
+    std::string path = findFile(filenm);
+    if(!ast->sourceHashes.count(path) || stat(path.c_str(), &st)) return false;
+
+    stamp.path = path;
+    stamp.mtime = modifiedTime(st);
+    stamp.size = st.st_size;
+    stamp.hash = ast->sourceHashes[path];
+    return true;
+}
+
+// records every file that went into the AST, including C headers
+// that can be found (system headers are not tracked)
+static void stampAST(AST *ast, std::vector<FileStamp> &files) {
+    FileStamp stamp;
+    if(ast->getRuntimeModule() && stampFile(ast, ast->getRuntimeModule()->filenm, stamp)) {
+        files.push_back(stamp);
+    }
+
+    std::map<std::string, ModuleDeclaration*>::iterator it;
+    for(it = ast->modules.begin(); it != ast->modules.end(); it++) {
+        if(stampFile(ast, it->first, stamp)) {
+            files.push_back(stamp);
+        }
+    }
+}
+
+static bool isCurrent(WarmAST &warm) {
+    for(int i = 0; i < warm.files.size(); i++) {
+        FileStamp &stamp = warm.files[i];
+        struct stat st;
+        if(stat(stamp.path.c_str(), &st) || st.st_size != stamp.size ||
+                modifiedTime(st).tv_sec != stamp.mtime.tv_sec ||
+                modifiedTime(st).tv_nsec != stamp.mtime.tv_nsec) {
+            return false;
+        }
+
+        // an edit can keep the size, and land within the mtime's resolution
+        uint64_t hash;
+        if(!hashSourceFile(stamp.path, hash) || hash != stamp.hash) return false;
+    }
+    return true;
+}
+
+static void dropWarm(std::string key) {
+    delete warmASTs[key].parser->getAST();
+    delete warmASTs[key].parser;
+    warmASTs.erase(key);
+}
+
+static Parser *getWarm(std::string key) {
+    if(!warmASTs.count(key)) return NULL;
+
+    if(!isCurrent(warmASTs[key])) {
+        dropWarm(key);
+        return NULL;
+    }
+
+    warmASTs[key].lastUse = ++useCounter;
+    return warmASTs[key].parser;
+}
+
+static void addWarm(std::string key, Parser *parser) {
+    if(warmASTs.size() >= MAX_WARM_ASTS) {
+        std::map<std::string, WarmAST>::iterator it, oldest = warmASTs.begin();
+        for(it = warmASTs.begin(); it != warmASTs.end(); it++) {
+            if(it->second.lastUse < oldest->second.lastUse) oldest = it;
+        }
+        dropWarm(oldest->first);
+    }
+
+    WarmAST warm;
+    warm.parser = parser;
+    warm.lastUse = ++useCounter;
+    stampAST(parser->getAST(), warm.files);
+    warmASTs[key] = warm;
+}
+
+static std::vector<char*> makeArgv(std::vector<std::string> &args) {
+    std::vector<char*> argv;
+    for(int i = 0; i < args.size(); i++) {
+        argv.push_back(strdup(args[i].c_str()));
+    }
+    argv.push_back(NULL);
+    return argv;
+}
+
+/*
+ * runs in the forked child. 'parser' is the warm state to start from, if any.
+ * all output goes to the client
+ */
+static void compileRequest(int fd, std::vector<std::string> &args, Parser *parser) {
+    dup2(fd, 1);
+    dup2(fd, 2);
+    close(fd);
+
+    resetErrorLevel();
+
+    std::vector<char*> argv = makeArgv(args);
+    WLConfig params = parseCmd(argv.size() - 1, &argv[0]);
+
+    int status = 0;
+    if(currentErrorLevel()) {
+        status = -1; // failure to parse args
+    } else if(params.serve) {
+        emit_message(msg::ERROR, "cannot start a server from a client request");
+    } else if(!params.files.size()) {
+        emit_message(msg::ERROR, "no input files");
+    } else {
+        if(params.timeReport || !params.timeTrace.empty()) enableTiming();
+        if(!parser) parser = new Parser;
+        parseSources(parser, params);
+        status = compileAST(parser->getAST(), params);
+    }
+
+    deinit(params);
+    if(!status && currentErrorLevel() > msg::WARNING) status = currentErrorLevel();
+
+    std::cout.flush();
+    std::cerr.flush();
+    char trailer[2] = { 0, (char) status };
+    write(1, trailer, 2);
+    _exit(status);
+}
+
+static void warmRequest(PendingRequest &req) {
+    if(chdir(req.cwd.c_str())) return;
+
+    if(req.warmRuntime && !warmASTs.count(runtimeKey(req.cwd))) {
+        Parser *parser = new Parser;
+        parser->getAST()->hashSources = true;
+        WLConfig params;
+        parseSources(parser, params); // no files; only the runtime
+        addWarm(runtimeKey(req.cwd), parser);
+    }
+
+    if(req.warmSources && !warmASTs.count(sourcesKey(req.cwd, req.args))) {
+        std::vector<char*> argv = makeArgv(req.args);
+        WLConfig params = parseCmd(argv.size() - 1, &argv[0]);
+        deinit(params);
+
+        Parser *parser = new Parser;
+        parser->getAST()->hashSources = true;
+        parseSources(parser, params);
+        addWarm(sourcesKey(req.cwd, req.args), parser);
+    }
+
+    // the compile already succeeded with these sources; anything reported
+    // while warming is not an error of the server
+    resetErrorLevel();
+}
+
+static void reapWorkers() {
+    int status;
+    pid_t pid;
+    while((pid = waitpid(-1, &status, WNOHANG)) > 0) {
+        if(!pending.count(pid)) continue;
+
+        PendingRequest req = pending[pid];
+        pending.erase(pid);
+        if(WIFEXITED(status) && WEXITSTATUS(status) == 0) {
+            warmRequest(req);
+        }
+    }
+}
+
+static bool readRequest(int fd, std::string &cwd, std::vector<std::string> &args) {
+    std::string data;
+    char buf[4096];
+    ssize_t n;
+    while((n = read(fd, buf, sizeof(buf))) != 0) {
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        data.append(buf, n);
+    }
+
+    size_t start = 0;
+    size_t end;
+    while((end = data.find('\0', start)) != std::string::npos) {
+        args.push_back(data.substr(start, end - start));
+        start = end + 1;
+    }
+
+    if(args.size() < 2) return false;
+    cwd = args[0];
+    args.erase(args.begin());
+    return true;
+}
+
+static void handleRequest(int fd) {
+    std::string cwd;
+    std::vector<std::string> args;
+    if(!readRequest(fd, cwd, args) || chdir(cwd.c_str())) {
+        close(fd);
+        return;
+    }
+
+    Parser *parser = getWarm(sourcesKey(cwd, args));
+    bool sourcesWarm = parser != NULL;
+    bool runtimeWarm = getWarm(runtimeKey(cwd)) != NULL;
+    if(!parser) parser = getWarm(runtimeKey(cwd));
+
+    std::cout.flush();
+    fflush(NULL);
+
+    pid_t pid = fork();
+    if(pid == 0) {
+        compileRequest(fd, args, parser);
+    }
+
+    close(fd);
+    if(pid < 0) {
+        emit_message(msg::WARNING, "unable to fork for compile request");
+        resetErrorLevel();
+        return;
+    }
+
+    if(!sourcesWarm || !runtimeWarm) {
+        PendingRequest req;
+        req.cwd = cwd;
+        req.args = args;
+        req.warmSources = !sourcesWarm;
+        req.warmRuntime = !runtimeWarm;
+        pending[pid] = req;
+    }
+}
+
+static void onChild(int sig) {
+    // only here to interrupt accept(), children are reaped in the main loop
+}
+
+// the server's own executable; requests change the working directory, so a
+// relative argv[0] is resolved before the first one
+static std::string serverExecutable(std::string cmd) {
+    char buf[PATH_MAX];
+    if(cmd.find('/') != std::string::npos && realpath(cmd.c_str(), buf)) return buf;
+    return cmd; // found through PATH
+}
+
+// replaces the server with a fresh one on the same socket path. compiles
+// that are still running are unaffected; they only lose their warming.
+// returns only if the server could not be started again
+static void restartServer(std::string exe, std::string socketPath) {
+    std::string opt = "--server=" + socketPath;
+    char *argv[] = { (char*) exe.c_str(), (char*) opt.c_str(), NULL };
+    std::cout.flush();
+    fflush(NULL);
+    execvp(argv[0], argv);
+    emit_message(msg::WARNING, "unable to restart the server: " + std::string(strerror(errno)));
+    resetErrorLevel();
+}
+
+int runServer(WLConfig &config) {
+    std::string exe = serverExecutable(config.cmd);
+    bool restartFailed = false;
+
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(config.socketPath.length() >= sizeof(addr.sun_path)) {
+        emit_message(msg::ERROR, "socket path too long: " + config.socketPath);
+        return -1;
+    }
+    strcpy(addr.sun_path, config.socketPath.c_str());
+
+    // only replace a stale socket of our own, never somebody else's file
+    struct stat st;
+    if(!lstat(config.socketPath.c_str(), &st)) {
+        if(!isOwnedBy(st, S_IFSOCK)) {
+            emit_message(msg::ERROR, "'" + config.socketPath + "' exists and is not our socket");
+            return -1;
+        }
+        unlink(config.socketPath.c_str());
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    mode_t mask = umask(077);
+    if(sock < 0 || bind(sock, (struct sockaddr*) &addr, sizeof(addr)) || listen(sock, 64)) {
+        umask(mask);
+        emit_message(msg::ERROR, "unable to listen on '" + config.socketPath + "': " + strerror(errno));
+        return -1;
+    }
+    umask(mask);
+    fcntl(sock, F_SETFD, FD_CLOEXEC); // a restarted server binds the path again
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = onChild;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGCHLD, &sa, NULL);
+    signal(SIGPIPE, SIG_IGN);
+
+    emit_message(msg::OUTPUT, "wlc server listening on " + config.socketPath);
+
+    while(true) {
+        reapWorkers();
+
+        // on failure, keep serving from this process
+        if(!restartFailed && internedBytes() > MAX_INTERNED_BYTES) {
+            emit_message(msg::OUTPUT, "wlc server restarting to release interned strings");
+            restartServer(exe, config.socketPath);
+            restartFailed = true;
+        }
+
+        int fd = accept(sock, NULL, NULL);
+        if(fd < 0) continue; // interrupted by SIGCHLD
+
+        reapWorkers();
+        handleRequest(fd);
+    }
+
+    return 0;
+}
+
+static bool writeAll(int fd, const char *data, size_t len) {
+    while(len) {
+        ssize_t n = write(fd, data, len);
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        len -= n;
+    }
+    return true;
+}
+
+int runClient(std::string socketPath, int argc, char **argv) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if(socketPath.length() >= sizeof(addr.sun_path)) return -1;
+    strcpy(addr.sun_path, socketPath.c_str());
+
+    // don't hand our sources and command line to another user's server
+    struct stat st;
+    if(lstat(socketPath.c_str(), &st)) return -1;
+    if(!isOwnedBy(st, S_IFSOCK)) {
+        emit_message(msg::WARNING, "'" + socketPath + "' is not a socket owned by this user");
+        return -1;
+    }
+
+    int sock = socket(AF_UNIX, SOCK_STREAM, 0);
+    if(sock < 0) return -1;
+    if(connect(sock, (struct sockaddr*) &addr, sizeof(addr))) {
+        close(sock);
+        return -1;
+    }
+
+#ifdef SO_PEERCRED
+    // the path could have been swapped between lstat and connect
+    struct ucred cred;
+    socklen_t credlen = sizeof(cred);
+    if(getsockopt(sock, SOL_SOCKET, SO_PEERCRED, &cred, &credlen) || cred.uid != getuid()) {
+        emit_message(msg::WARNING, "compile server at '" + socketPath + "' is not run by this user");
+        close(sock);
+        return -1;
+    }
+#endif
+
+    char cwd[PATH_MAX];
+    if(!getcwd(cwd, sizeof(cwd))) {
+        close(sock);
+        return -1;
+    }
+
+    std::string request = std::string(cwd) + '\0';
+    for(int i = 0; i < argc; i++) {
+        if(!strcmp(argv[i], "--connect") || !strncmp(argv[i], "--connect=", 10)) continue;
+        request += std::string(argv[i]) + '\0';
+    }
+
+    if(!writeAll(sock, request.data(), request.length())) {
+        close(sock);
+        return -1;
+    }
+    shutdown(sock, SHUT_WR);
+
+    // relay output as it arrives, holding back what may be the trailer
+    std::string held;
+    char buf[4096];
+    ssize_t n;
+    while((n = read(sock, buf, sizeof(buf))) != 0) {
+        if(n < 0) {
+            if(errno == EINTR) continue;
+            break;
+        }
+        held.append(buf, n);
+        if(held.length() > 2) {
+            fwrite(held.data(), 1, held.length() - 2, stderr);
+            held.erase(0, held.length() - 2);
+        }
+    }
+    close(sock);
+
+    if(held.length() == 2 && held[0] == '\0') {
+        return (unsigned char) held[1];
+    }
+
+    fwrite(held.data(), 1, held.length(), stderr);
+    emit_message(msg::ERROR, "compile server closed the connection unexpectedly");
+    return msg::ERROR;
+}
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef _SERVER_HPP
+#define _SERVER_HPP
+
+#include <string>
+
+#include "config.hpp"
+
+/*
+ * compile server (wlc --server) and its client (wlc --connect ...).
+ *
+ * the server keeps parsed ASTs in memory between requests; each request
+ * is compiled in a forked copy of the server, so the warm ASTs are never
+ * modified by validation or codegen.
+ */
+
+// $XDG_RUNTIME_DIR/wlc.sock, or wlc.sock in a private /tmp/wlc-<uid>/
+std::string defaultSocketPath();
+
+// serves requests until killed. returns non-zero on failure to start
+int runServer(WLConfig &config);
+
+// sends the command line to a server and relays its output.
+// returns the compile's exit status, or -1 if the server could not be reached
+int runClient(std::string socketPath, int argc, char **argv);
+
+#endif
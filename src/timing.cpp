@@ -0,0 +1,269 @@
+#include "timing.hpp"
+#include "message.hpp"
+
+#include <llvm/Support/TimeValue.h>
+#include <llvm/Support/Mutex.h>
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#include <fstream>
+#include <vector>
+#include <map>
+
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+#ifdef _MSC_VER
+#define THREAD_LOCAL __declspec(thread)
+#else
+#define THREAD_LOCAL __thread
+#endif
+
+struct TimeSpan
+{
+    const char *phase;
+    std::string detail;
+    uint64_t start; // microseconds since timing was enabled
+    uint64_t duration;
+    uint64_t nested; // time spent in spans nested in this one
+    long peakRSS; // at the end of the span
+    int parent; // enclosing span on the same thread, or -1
+    int thread;
+};
+
+static bool enabled = false;
+static uint64_t epoch = 0;
+static std::vector<TimeSpan> spans;
+
+// spans are opened from parsing threads too. each thread nests its own
+static llvm::sys::Mutex spanLock;
+static THREAD_LOCAL int openSpan = -1;
+static THREAD_LOCAL int threadId = 0; // numbered from 1 as threads first open a span
+static int nThreads = 0;
+
+struct CacheCount
+{
+    const char *cache;
+    uint64_t hits;
+    uint64_t lookups;
+};
+
+static std::vector<CacheCount> caches; // in the order first used
+
+struct FieldReordering
+{
+    std::string type;
+    size_t before; // object size in declaration order
+    size_t after;
+};
+
+static std::vector<FieldReordering> reorderings;
+
+static uint64_t now() {
+    return llvm::sys::TimeValue::now().usec() - epoch;
+}
+
+void enableTiming() {
+    if(enabled) return;
+    enabled = true;
+    epoch = 0;
+    epoch = now();
+}
+
+bool timingEnabled() {
+    return enabled;
+}
+
+long getPeakRSS() {
+#ifdef WIN32
+    return 0;
+#else
+    struct rusage usage;
+    if(getrusage(RUSAGE_SELF, &usage)) return 0;
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on OSX
+#else
+    return usage.ru_maxrss;
+#endif
+#endif
+}
+
+TimeScope::TimeScope(const char *phase, std::string detail) : span(-1) {
+    if(!enabled) return;
+
+    llvm::sys::ScopedLock guard(spanLock);
+    if(!threadId) threadId = ++nThreads;
+
+    TimeSpan s;
+    s.phase = phase;
+    s.detail = detail;
+    s.duration = 0;
+    s.nested = 0;
+    s.peakRSS = 0;
+    s.parent = openSpan;
+    s.thread = threadId;
+
+    span = spans.size();
+    openSpan = span;
+    spans.push_back(s);
+
+    // start the clock last, so bookkeeping is not charged to the span
+    spans[span].start = now();
+}
+
+TimeScope::~TimeScope() {
+    if(span < 0) return;
+
+    uint64_t end = now();
+    long rss = getPeakRSS();
+
+    llvm::sys::ScopedLock guard(spanLock);
+    TimeSpan &s = spans[span];
+    s.duration = end - s.start;
+    s.peakRSS = rss;
+
+    openSpan = s.parent;
+    if(s.parent >= 0) {
+        spans[s.parent].nested += s.duration;
+    }
+}
+
+void countCacheLookup(const char *cache, bool hit) {
+    if(!enabled) return;
+
+    llvm::sys::ScopedLock guard(spanLock);
+    int i = 0;
+    while(i < caches.size() && strcmp(caches[i].cache, cache)) i++;
+    if(i == caches.size()) {
+        CacheCount c = { cache, 0, 0 };
+        caches.push_back(c);
+    }
+    caches[i].lookups++;
+    if(hit) caches[i].hits++;
+}
+
+void reportFieldReordering(std::string type, size_t before, size_t after) {
+    if(!enabled) return;
+
+    llvm::sys::ScopedLock guard(spanLock);
+    FieldReordering r = { type, before, after };
+    reorderings.push_back(r);
+}
+
+void printTimeReport(std::ostream &out) {
+    std::vector<const char*> order; // phases, in the order first seen
+    std::map<std::string, uint64_t> times;
+    std::map<std::string, int> counts;
+
+    for(int i = 0; i < spans.size(); i++) {
+        std::string phase = spans[i].phase;
+        if(!counts.count(phase)) {
+            order.push_back(spans[i].phase);
+            times[phase] = 0;
+            counts[phase] = 0;
+        }
+        times[phase] += spans[i].duration - spans[i].nested;
+        counts[phase]++;
+    }
+
+    uint64_t total = now();
+    char line[128];
+
+    out << "===---------------------------------------------------===\n";
+    out << "                    wlc time report\n";
+    out << "===---------------------------------------------------===\n";
+    sprintf(line, "  %-16s %8s %14s %8s\n", "phase", "count", "time (ms)", "%");
+    out << line;
+    for(int i = 0; i < order.size(); i++) {
+        std::string phase = order[i];
+        sprintf(line, "  %-16s %8d %14.3f %7.1f%%\n", order[i], counts[phase],
+                times[phase] / 1000.0, total ? 100.0 * times[phase] / total : 0.0);
+        out << line;
+    }
+    sprintf(line, "  %-16s %8s %14.3f\n", "total", "", total / 1000.0);
+    out << line;
+    sprintf(line, "  peak RSS: %ld KB\n", getPeakRSS());
+    out << line;
+
+    if(caches.size()) {
+        sprintf(line, "\n  %-24s %12s %12s %8s\n", "cache", "hits", "lookups", "hit rate");
+        out << line;
+    }
+    for(int i = 0; i < caches.size(); i++) {
+        sprintf(line, "  %-24s %12llu %12llu %7.1f%%\n", caches[i].cache,
+                (unsigned long long) caches[i].hits, (unsigned long long) caches[i].lookups,
+                100.0 * caches[i].hits / caches[i].lookups);
+        out << line;
+    }
+
+    // only the classes that got smaller
+    size_t saved = 0;
+    for(int i = 0; i < reorderings.size(); i++) {
+        FieldReordering &r = reorderings[i];
+        if(r.after >= r.before) continue;
+        if(!saved) {
+            sprintf(line, "\n  %-24s %12s %12s %8s\n", "reordered class", "size", "reordered", "saved");
+            out << line;
+        }
+        sprintf(line, "  %-24s %12lu %12lu %8lu\n", r.type.c_str(), (unsigned long) r.before,
+                (unsigned long) r.after, (unsigned long) (r.before - r.after));
+        out << line;
+        saved += r.before - r.after;
+    }
+    if(saved) {
+        sprintf(line, "  %-24s %12s %12s %8lu\n", "total", "", "", (unsigned long) saved);
+        out << line;
+    }
+}
+
+static std::string escapeJSON(std::string str) {
+    std::string ret;
+    for(int i = 0; i < str.length(); i++) {
+        char c = str[i];
+        if(c == '"' || c == '\\') {
+            ret += '\\';
+            ret += c;
+        } else if((unsigned char) c < 0x20) {
+            char buf[8];
+            sprintf(buf, "\\u%04x", c);
+            ret += buf;
+        } else {
+            ret += c;
+        }
+    }
+    return ret;
+}
+
+bool writeTimeTrace(std::string filenm) {
+    std::ofstream out(filenm.c_str());
+    if(!out) {
+        emit_message(msg::ERROR, "unable to write time trace '" + filenm + "'");
+        return false;
+    }
+
+    out << "{\"traceEvents\":[\n";
+    for(int i = 0; i < spans.size(); i++) {
+        TimeSpan &s = spans[i];
+        std::string name = s.detail.empty() ? s.phase : std::string(s.phase) + " " + s.detail;
+
+        out << "{\"name\":\"" << escapeJSON(name) << "\",\"cat\":\"" << s.phase << "\","
+            << "\"ph\":\"X\",\"pid\":1,\"tid\":" << s.thread << ","
+            << "\"ts\":" << s.start << ",\"dur\":" << s.duration << ","
+            << "\"args\":{\"detail\":\"" << escapeJSON(s.detail) << "\","
+            << "\"peak RSS (KB)\":" << s.peakRSS << "}},\n";
+
+        // counter track, so memory growth shows up alongside the spans
+        out << "{\"name\":\"peak RSS\",\"ph\":\"C\",\"pid\":1,"
+            << "\"ts\":" << s.start + s.duration << ","
+            << "\"args\":{\"KB\":" << s.peakRSS << "}},\n";
+    }
+
+    out << "{\"name\":\"total\",\"cat\":\"wlc\",\"ph\":\"X\",\"pid\":1,\"tid\":0,"
+        << "\"ts\":0,\"dur\":" << now() << ","
+        << "\"args\":{\"peak RSS (KB)\":" << getPeakRSS() << "}}\n";
+    out << "]}\n";
+    return true;
+}
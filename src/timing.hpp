@@ -0,0 +1,44 @@
+#ifndef _TIMING_HPP
+#define _TIMING_HPP
+
+#include <string>
+#include <ostream>
+
+/*
+ * compile phase timing, for -ftime-report and -ftime-trace.
+ *
+ * a TimeScope records one span (a phase, and optionally the module it
+ * worked on) from construction to destruction. spans may nest; the report
+ * charges each phase only for time not spent in nested spans. spans on
+ * different threads (parallel parsing) do not nest in each other.
+ * does nothing until timing is enabled.
+ */
+
+void enableTiming();
+bool timingEnabled();
+
+class TimeScope
+{
+    int span;
+
+    public:
+    TimeScope(const char *phase, std::string detail = "");
+    ~TimeScope();
+};
+
+// a hit or miss of a named cache; -ftime-report shows each cache's hit rate
+void countCacheLookup(const char *cache, bool hit);
+
+// a class whose fields were reordered; -ftime-report shows the bytes each saves
+void reportFieldReordering(std::string type, size_t before, size_t after);
+
+// peak resident set size of the compiler, in kilobytes (0 if unknown)
+long getPeakRSS();
+
+// summary table of time spent per phase
+void printTimeReport(std::ostream &out);
+
+// chrome trace event JSON (chrome://tracing), one event per span
+bool writeTimeTrace(std::string filenm);
+
+#endif
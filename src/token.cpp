@@ -265,7 +265,7 @@ int getUnaryPrecidence(tok::TokenKind tkind)
 Token::Token(TokenKind k, std::string st) : kind(k)
 {
     if(kind == tok::charstring || kind == tok::identifier)
-        strData = new std::string(st);
+        strData = intern(st);
     else if(kind == tok::intNum)
     {
         iData = atoll(st.c_str());
@@ -293,8 +293,7 @@ Token::Token(const Token &other)
     characters = other.characters;
     newline = other.newline;
     loc = other.loc;
-    if(other.is(tok::charstring) || other.is(tok::identifier)) strData = new std::string(*other.strData);
-    else iData = other.iData;
+    iData = other.iData; // interned strings are shared
 }
 
 Token::~Token()
@@ -350,3 +349,12 @@ std::string Token::toString()
     }
     return getSpelling();
 }
+
+InternedString Token::internedString()
+{
+    if(is(tok::identifier))
+    {
+        return strData;
+    }
+    return intern(getSpelling());
+}
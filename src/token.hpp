@@ -4,8 +4,10 @@
 
 #include <string>
 #include <stdint.h>
+#include <limits.h>
 
 #include "sourceLocation.hpp"
+#include "intern.hpp"
 
 namespace tok
 {
@@ -98,7 +100,7 @@ struct Token
 
     union
     {
-        std::string *strData; // no union with classes
+        InternedString strData; // no union with classes
         int64_t iData;
         uint64_t uiData;
         double fData;
@@ -107,6 +109,7 @@ struct Token
     Token() : kind(tok::none), iData(0) {}
 	Token(TokenKind k) : kind(k), iData(0) { }
     Token(TokenKind k, std::string st);
+    Token(TokenKind k, InternedString st) : kind(k), strData(st) {}
     Token(TokenKind k, double data);
     Token(const Token &other);
     ~Token();
@@ -126,7 +129,7 @@ struct Token
     //TODO: parse other datatypes as float?
     double floatData() { if(kind == tok::floatNum) { return fData; } return 0.0; }
 
-    void setLength(short toklen) { characters = toklen; }
+    void setLength(size_t toklen) { characters = toklen < USHRT_MAX ? toklen : USHRT_MAX; } // saturates
     std::string getSpelling();
     void dump();
 
@@ -151,6 +154,7 @@ struct Token
     int getUnaryPrecidence() { return ::getUnaryPrecidence((TokenKind) kind); }
 
     std::string toString();
+    InternedString internedString(); // toString(), without a copy for identifiers
 };
 
 #endif
@@ -0,0 +1,50 @@
+#ifndef _TOKENLEXER_HPP
+#define _TOKENLEXER_HPP
+
+#include <stdio.h>
+#include <vector>
+
+#include "token.hpp"
+#include "lexer.hpp"
+
+/*
+ * replays tokens that were lexed earlier (eg. a function body skipped by
+ * -flazy-parse). tokens keep their original locations. once the tokens
+ * run out, the lexer is at eof
+ */
+class TokenLexer : public Lexer
+{
+    const std::vector<Token> &tokens;
+    size_t next;
+
+    public:
+    TokenLexer(const std::vector<Token> &toks) : tokens(toks), next(0)
+    {
+        advance();
+    }
+
+    virtual int peekChar() { return EOF; }
+    virtual void ignoreChar() {}
+    virtual int getChar() { return EOF; }
+    virtual bool eofChar() { return true; }
+
+    virtual bool advance()
+    {
+        if(next < tokens.size())
+        {
+            current = tokens[next++];
+        } else
+        {
+            current = Token(tok::eof);
+            if(tokens.size()) current.loc = tokens.back().loc;
+        }
+        return current.isNot(tok::eof);
+    }
+
+    virtual SourceLocation getLocation()
+    {
+        return current.loc;
+    }
+};
+
+#endif
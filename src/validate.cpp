@@ -57,7 +57,7 @@ ASTType *ValidationVisitor::resolveType(ASTType *ty) {
 
     if(ASTFunctionType *fty = ty->asFunctionType()) {
         for(int i = 0; i < fty->params.size(); i++){
-            fty->params[i] = resolveType(fty->params[i]);
+            resolveType(fty->params[i]); // shared type; resolved in place
         }
 
         if(fty->owner){
@@ -414,6 +414,15 @@ void ValidationVisitor::visitDotExpression(DotExpression *exp) {
         emit_message(msg::ERROR, "invalid base in dot expression", exp->loc);
     }
 
+    // the member itself is looked up when lowered
+    if(exp->rhs == "offsetof") {
+        DotExpression *member = exp->lhs->dotExpression();
+        if(!member || !member->lhs->isType()) {
+            emit_message(msg::ERROR, "invalid 'offsetof'; expected 'Type.member.offsetof'", currentLocation());
+        }
+        return;
+    }
+
     if(exp->lhs->isValue()) {
         ASTType *lhstype = exp->lhs->getType();
         Identifier *rhsid = NULL;
@@ -478,7 +487,7 @@ void ValidationVisitor::visitDotExpression(DotExpression *exp) {
             emit_message(msg::ERROR, "invalid lhs of dot expression", currentLocation());
         }
 
-        if(exp->rhs == "sizeof" || exp->rhs == "offsetof") {
+        if(exp->rhs == "sizeof") {
             // i think we're fine
         } else {
             //TODO: look up static members / functions
@@ -0,0 +1,9 @@
+import "util.wl"
+
+extern undecorated int printf(char^ fmt, ...);
+
+int main(int argc, char^^ argv)
+{
+    printf("%d\n", twice(21))
+    return 0
+}
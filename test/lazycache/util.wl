@@ -0,0 +1,4 @@
+int twice(int i)
+{
+    return i * 2
+}
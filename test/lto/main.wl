@@ -0,0 +1,8 @@
+extern undecorated int printf(char^fmt, ...);
+extern undecorated int square(int x);
+
+int main(int argc, char^^ argv)
+{
+    printf("square: %d\n", square(7))
+    return 0
+}
@@ -0,0 +1,85 @@
+extern undecorated int printf(char ^fmt, ...);
+
+struct Padded
+{
+    char c
+    long l
+    short s
+}
+
+union Either
+{
+    char c
+    double d
+}
+
+class Base
+{
+    int a
+}
+
+class Derived : Base
+{
+    char b
+    double d
+}
+
+class Loose
+{
+    char a
+    long b
+    char c
+    int d
+}
+
+int mismatches = 0
+
+// offsetof and sizeof are computed apart from the LLVM types that codegen
+// builds; 'actual' is measured on an object in memory
+void check(char^ what, long computed, long actual)
+{
+    if(computed != actual) {
+        printf("%s: %ld, but %ld in memory\n", what, computed, actual)
+        mismatches += 1
+    }
+}
+
+long between(void^ from, void^ to)
+{
+    return (long: to) - (long: from)
+}
+
+int main(int argc, char^^ argv)
+{
+    printf("%ld %ld %ld %ld\n", Padded.c.offsetof, Padded.l.offsetof, Padded.s.offsetof, Padded.sizeof)
+    printf("%ld %ld\n", Either.d.offsetof, Either.sizeof)
+    printf("%ld %ld %ld %ld\n", Derived.refcount.offsetof, Derived.a.offsetof, Derived.b.offsetof, Derived.d.offsetof)
+
+    Padded[2] padded
+    check("Padded.c", Padded.c.offsetof, between(&padded[0], &padded[0].c))
+    check("Padded.l", Padded.l.offsetof, between(&padded[0], &padded[0].l))
+    check("Padded.s", Padded.s.offsetof, between(&padded[0], &padded[0].s))
+    check("Padded.sizeof", Padded.sizeof, between(&padded[0], &padded[1]))
+
+    Either[2] either
+    check("Either.c", Either.c.offsetof, between(&either[0], &either[0].c))
+    check("Either.d", Either.d.offsetof, between(&either[0], &either[0].d))
+    check("Either.sizeof", Either.sizeof, between(&either[0], &either[1]))
+
+    Derived derived = new Derived
+    check("Derived.refcount", Derived.refcount.offsetof, between(void^: derived, &derived.refcount))
+    check("Derived.a", Derived.a.offsetof, between(void^: derived, &derived.a))
+    check("Derived.b", Derived.b.offsetof, between(void^: derived, &derived.b))
+    check("Derived.d", Derived.d.offsetof, between(void^: derived, &derived.d))
+
+    // reordered: b, d, a, c
+    Loose loose = new Loose
+    check("Loose.refcount", Loose.refcount.offsetof, between(void^: loose, &loose.refcount))
+    check("Loose.a", Loose.a.offsetof, between(void^: loose, &loose.a))
+    check("Loose.b", Loose.b.offsetof, between(void^: loose, &loose.b))
+    check("Loose.c", Loose.c.offsetof, between(void^: loose, &loose.c))
+    check("Loose.d", Loose.d.offsetof, between(void^: loose, &loose.d))
+
+    if(!mismatches) printf("layout matches\n")
+    return 0
+}
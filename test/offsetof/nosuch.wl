@@ -0,0 +1,11 @@
+union Either
+{
+    char c
+    double d
+}
+
+int main(int argc, char^^ argv)
+{
+    long o = Either.nosuch.offsetof // error: member 'nosuch' not found
+    return 0
+}
@@ -0,0 +1,26 @@
+extern undecorated int printf(char ^fmt, ...);
+
+class Loose
+{
+    char a
+    long b
+    char c
+    int d
+
+    this() {
+        .a = 1
+        .b = 2
+        .c = 3
+        .d = 4
+    }
+}
+
+int main(int argc, char^^ argv)
+{
+    Loose l = new Loose()
+    printf("%d %d %d %d\n", l.a, l.b, l.c, l.d)
+    printf("%ld %ld %ld %ld %ld\n", Loose.refcount.offsetof, Loose.b.offsetof, Loose.d.offsetof,
+        Loose.a.offsetof, Loose.c.offsetof)
+    printf("%ld\n", Loose.sizeof)
+    return 0
+}
@@ -0,0 +1,12 @@
+extern undecorated int printf(char^fmt, ...);
+
+int main(int argc, char^^ argv)
+{
+    int i = 1
+    while(i < argc)
+    {
+        printf("%s\n", argv[i])
+        i = i + 1
+    }
+    return 0
+}
@@ -0,0 +1,30 @@
+extern undecorated int printf(char^ fmt, ...);
+
+class Named
+{
+    char^ name
+
+    this(char^ n) {
+        .name = n
+    }
+
+    ~this() {
+        printf("release %s\n", .name)
+    }
+}
+
+// locals are released at the end of their scope in name order, as they
+// always have been, not in the order they are declared
+void locals()
+{
+    Named zulu = new Named("zulu")
+    Named alpha = new Named("alpha")
+    Named mike = new Named("mike")
+    printf("end of scope\n")
+}
+
+int main(int argc, char^^ argv)
+{
+    locals()
+    return 0
+}
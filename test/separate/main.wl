@@ -0,0 +1,13 @@
+import "util.wl"
+
+extern undecorated int printf(char^fmt, ...);
+
+int main(int argc, char^^ argv)
+{
+    Counter c
+    initCounter(&c, 3)
+    tick(&c)
+    tick(&c)
+    printf("count: %d\n", tick(&c))
+    return 0
+}
@@ -0,0 +1,5 @@
+// an unrelated module that happens to share util.wl's name
+int untick(int n)
+{
+    return n - 1
+}
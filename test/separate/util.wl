@@ -0,0 +1,17 @@
+struct Counter
+{
+    int count
+    int step
+}
+
+void initCounter(Counter^ c, int step)
+{
+    c.count = 0
+    c.step = step
+}
+
+int tick(Counter^ c)
+{
+    c.count = c.count + c.step
+    return c.count
+}
@@ -1,6 +1,7 @@
 tdirs="all construct gltest libvec postdecl switch vararg\
     array coerce crossimport importc logic_exp retain weak cast delete interface\
-    overload stack tuple class funcptr labels pack struct static union ufcs virtual"
+    overload stack tuple class funcptr labels pack struct static union ufcs virtual\
+    separate lto run offsetof reorder scopeorder lazycache"
 
 for dir in $tdirs; do
     cd $dir